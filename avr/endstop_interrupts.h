@@ -0,0 +1,106 @@
+#ifndef AVR_ENDSTOP_INTERRUPTS_H
+#define AVR_ENDSTOP_INTERRUPTS_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdint.h>
+#include "src/stepper.h"
+#include "src/stepper_group.h"
+#include "fast_pin.h"
+
+/** Endstops of one port on the pin change interrupt.
+
+    Steppers, or axes of one StepperGroup, attached to a pin of port P
+    are switched to interrupt endstop detection, and their on_endstop()
+    is called when the pin goes high. An endstop that is already high
+    when attached or when its trigger is cleared is latched by the
+    stepper itself, since there is no edge for it. Steppers with
+    endstops that are not attached keep polling in unstep().
+    on_change() is called from the pin change vector of the port, for
+    port C:
+
+      ISR(PCINT2_vect) {
+        EndstopInterrupts<Port::C>::on_change();
+      }
+
+    The vector must not be nested with the step interrupt, which holds
+    for plain ISR() handlers.
+ */
+template <Port P>
+class EndstopInterrupts {
+ public:
+  /// Report changes of pin to stepper, pin must be on port P
+  static void attach(Stepper *stepper, PinIo::Pin pin) {
+    steppers[pin.pin_no & 7] = stepper;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      enable(pin);
+      // Latches at once if the endstop is already active
+      stepper->use_endstop_interrupt(true);
+    }
+  }
+
+  /// Report changes of pin to axis of group, pin must be on port P
+  /** All axes attached on port P must be of the same group.
+   */
+  static void attach(StepperGroup *group, uint8_t axis, PinIo::Pin pin) {
+    EndstopInterrupts::group = group;
+    group_axes[pin.pin_no & 7] = axis;
+    group_mask |= 1 << axis;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      enable(pin);
+      // Latches at once if the endstop is already active
+      group->use_endstop_interrupt(group_mask);
+    }
+  }
+
+  static void on_change() {
+    uint8_t levels = PortRegisters<P>::in();
+    uint8_t rising = levels & ~last & PortRegisters<P>::pcmsk();
+    last = levels;
+    for (uint8_t ind = 0; rising; ind++, rising >>= 1) {
+      if (rising & 1) {
+	if (steppers[ind]) {
+	  steppers[ind]->on_endstop();
+	}
+	else {
+	  group->on_endstop(group_axes[ind]);
+	}
+      }
+    }
+  }
+
+ private:
+  /// Enable the pin change interrupt of pin, interrupts must be off.
+  /** Enabled before the level is read, so a rise after reading raises
+      the flag and is handled when interrupts are enabled again.
+   */
+  static void enable(PinIo::Pin pin) {
+    uint8_t bit = PinIo::bit(pin);
+    PortRegisters<P>::pcmsk() |= bit;
+    PCICR |= _BV(PortRegisters<P>::pcie);
+    last = (last & ~bit) | (PortRegisters<P>::in() & bit);
+  }
+
+  static Stepper *steppers[8];
+  static StepperGroup *group;
+  static uint8_t group_axes[8];
+  static StepperGroup::Mask group_mask;
+  static uint8_t last;
+};
+
+template <Port P>
+Stepper *EndstopInterrupts<P>::steppers[8];
+
+template <Port P>
+StepperGroup *EndstopInterrupts<P>::group = nullptr;
+
+template <Port P>
+uint8_t EndstopInterrupts<P>::group_axes[8];
+
+template <Port P>
+StepperGroup::Mask EndstopInterrupts<P>::group_mask = 0;
+
+template <Port P>
+uint8_t EndstopInterrupts<P>::last = 0;
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef AVR_FAST_PIN_H
+#define AVR_FAST_PIN_H
+
+#include <avr/io.h>
+#include <stdint.h>
+#include "src/pin_io.h"
+
+/// Ports of the ATmega644p
+enum class Port : uint8_t { A, B, C, D };
+
+/// Registers of a port
+template <Port P> struct PortRegisters;
+
+#define FAST_PIN_PORT(letter, index)					\
+  template <> struct PortRegisters<Port::letter> {			\
+    static volatile uint8_t& out() { return PORT##letter; }		\
+    static volatile uint8_t& in() { return PIN##letter; }		\
+    static volatile uint8_t& ddr() { return DDR##letter; }		\
+    static volatile uint8_t& pcmsk() { return PCMSK##index; }		\
+    static const uint8_t pcie = PCIE##index;				\
+  }
+
+FAST_PIN_PORT(A, 0);
+FAST_PIN_PORT(B, 1);
+FAST_PIN_PORT(C, 2);
+FAST_PIN_PORT(D, 3);
+
+#undef FAST_PIN_PORT
+
+/** Pin with port and bit known at compile time.
+
+    The registers of all ports are in the low I/O space, so with the
+    address and bit as constants set() and clear() compile to single
+    sbi/cbi instructions and get() to sbic/sbis. Used as pin types of
+    StaticStepper.
+ */
+template <Port P, uint8_t Bit>
+struct FastPin {
+  static_assert(Bit < 8, "FastPin bit out of range");
+
+  /// Same numbering as PinIo, pin_no/8 is the port
+  static const uint8_t pin_no = static_cast<uint8_t>(P)*8 + Bit;
+
+  static PinIo::Pin pin() {
+    return PinIo::Pin{pin_no};
+  }
+
+  static void set() {
+    PortRegisters<P>::out() |= _BV(Bit);
+  }
+
+  static void clear() {
+    PortRegisters<P>::out() &= ~_BV(Bit);
+  }
+
+  static bool get() {
+    return PortRegisters<P>::in() & _BV(Bit);
+  }
+
+  static void make_output() {
+    PortRegisters<P>::ddr() |= _BV(Bit);
+  }
+
+  /// Input, with the pull-up enabled if pull_up
+  static void make_input(bool pull_up = false) {
+    PortRegisters<P>::ddr() &= ~_BV(Bit);
+    if (pull_up) {
+      set();
+    }
+    else {
+      clear();
+    }
+  }
+};
+
+/// Pin that is not connected, for unused stepper pins.
+struct NoPin {
+  static void set() {}
+  static void clear() {}
+  static bool get() { return false; }
+  static void make_output() {}
+  static void make_input(bool = false) {}
+};
+
+/** PinIo on the port registers, for the runtime pin path.
+
+    Each call selects the port registers at runtime, and mask
+    operations write a whole port at once.
+ */
+class RegisterPinIo : public PinIo {
+ public:
+  void set(Pin pin) override {
+    out(port(pin)) |= bit(pin);
+  }
+
+  void clear(Pin pin) override {
+    out(port(pin)) &= ~bit(pin);
+  }
+
+  bool get(Pin pin) override {
+    return in(port(pin)) & bit(pin);
+  }
+
+  void set_mask(uint8_t port, uint8_t mask) override {
+    out(port) |= mask;
+  }
+
+  void clear_mask(uint8_t port, uint8_t mask) override {
+    out(port) &= ~mask;
+  }
+
+  void write_mask(uint8_t port, uint8_t mask, uint8_t value) override {
+    volatile uint8_t& reg = out(port);
+    reg = (reg & ~mask) | (value & mask);
+  }
+
+ private:
+  /// PORTx, PINx and DDRx of consecutive ports are 3 addresses apart
+  static volatile uint8_t& out(uint8_t port) {
+    return (&PORTA)[3*port];
+  }
+
+  static volatile uint8_t& in(uint8_t port) {
+    return (&PINA)[3*port];
+  }
+};
+
+#endif
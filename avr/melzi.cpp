@@ -1,8 +1,19 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <math.h>
 #include <stdlib.h>
 
-#include "src/scheduling_timer.h"
+#include "src/delta_gantry.h"
+#include "src/flow_control.h"
+#include "src/gcode_parser.h"
+#include "src/motion_pipeline.h"
+#include "src/planner.h"
+#include "src/stepper_group.h"
+#include "src/trapezoid_ticker.h"
+#include "endstop_interrupts.h"
+#include "fast_pin.h"
+#include "timer1.h"
+#include "uart.h"
 
 extern "C" void __cxa_pure_virtual(void) {}
 
@@ -29,72 +40,111 @@ void operator delete[](void * ptr)
 } 
 */
 
-class Timer1 {
-public:
-  Timer1() {
-    TCCR1A = 0;
-    TCNT1 = 0;
-    TCCR1B = _BV(CS11) | _BV(CS10) ; // F_CPU / 64
+namespace {
+  typedef FastPin<Port::D, 6> Enable;
+  typedef FastPin<Port::D, 7> XStep;
+  typedef FastPin<Port::C, 5> XDir;
+  typedef FastPin<Port::C, 2> XEndstop;
+  typedef FastPin<Port::C, 6> YStep;
+  typedef FastPin<Port::C, 7> YDir;
+  typedef FastPin<Port::C, 3> YEndstop;
+  typedef FastPin<Port::B, 3> ZStep;
+  typedef FastPin<Port::B, 2> ZDir;
+  typedef FastPin<Port::C, 4> ZEndstop;
+  typedef FastPin<Port::B, 1> EStep;
+  typedef FastPin<Port::B, 0> EDir;
+
+  /// Towers first, as DeltaGantry expects. E has no endstop.
+  const Stepper::Pins pins[] = {
+    {Enable::pin(), XStep::pin(), XDir::pin(), XEndstop::pin()},
+    {Enable::pin(), YStep::pin(), YDir::pin(), YEndstop::pin()},
+    {Enable::pin(), ZStep::pin(), ZDir::pin(), ZEndstop::pin()},
+    {Enable::pin(), EStep::pin(), EDir::pin(), StepperGroup::no_endstop},
+  };
+  const unsigned axes = sizeof(pins)/sizeof(pins[0]);
+
+  /// Driver direction setup time, 1 us in timer ticks
+  const uint32_t direction_setup = F_CPU/8/1000000;
+
+  void setup_pins() {
+    Enable::make_output();
+    XStep::make_output();
+    XDir::make_output();
+    YStep::make_output();
+    YDir::make_output();
+    ZStep::make_output();
+    ZDir::make_output();
+    EStep::make_output();
+    EDir::make_output();
+    // Normally closed switches to ground read high when triggered
+    XEndstop::make_input(true);
+    YEndstop::make_input(true);
+    ZEndstop::make_input(true);
   }
 
-  void set_callback(TimerCallback *cb) {
-    Timer1::cb = cb;
-  }
-
-  ~Timer1() {
-    stop_timer();
-    TCCR1B = 0; // Stop timer clock
-  }
-
-  uint32_t frequency() const {
-    return F_CPU/64;
-  }
-  void enable_interrupts() {
-    sei();
-  }
-  void disable_interrupts() {
-    cli();
-  }
-  void start_timer(uint16_t tick) {
-    OCR2A = tick;
-    TIMSK1 = _BV(OCIE1A);
-  }
-  void stop_timer() {
-    TIMSK1 = 0; // Clear interrupt mask
-    TCNT1 = 0; // Reset timestamp
-  }
-  uint16_t current_timestamp() {
-    return TCNT1;
-  }
-
-  static void isr() {
-    if (cb != nullptr) {
-      cb->on_timer();
+  DeltaGantry make_gantry() {
+    std::vector<DeltaGantry::Axis> axes(4, DeltaGantry::Axis{80, 1e-5, 1e-6});
+    std::vector<DeltaGantry::Tower> towers;
+    const float pi = 3.14159265f;
+    for (unsigned tower = 0; tower < 3; ++tower) {
+      float angle = pi/2 + tower*2*pi/3;
+      towers.push_back(DeltaGantry::Tower{
+	  {100*cosf(angle), 100*sinf(angle), 0}, 215});
     }
+    return DeltaGantry(axes, towers);
   }
-private:
-  static TimerCallback *cb;
-};
-
-TimerCallback *Timer1::cb = 0;
+}
 
-ISR(TIMER1_COMPA_vect) {
-  Timer1::isr();
+// Tower endstops are all on port C
+ISR(PCINT2_vect) {
+  EndstopInterrupts<Port::C>::on_change();
 }
 
+int main() {
+  setup_pins();
+  RegisterPinIo io;
+  Timer1 timer;
+  StepperGroup steppers(&io, pins, axes, &timer, direction_setup);
+  // Only the towers have endstops, and only they stop on them. Attached
+  // while disabled, so a tower already on its switch is latched but not
+  // stopped, and can leave.
+  EndstopInterrupts<Port::C>::attach(&steppers, 0, XEndstop::pin());
+  EndstopInterrupts<Port::C>::attach(&steppers, 1, YEndstop::pin());
+  EndstopInterrupts<Port::C>::attach(&steppers, 2, ZEndstop::pin());
+  steppers.enable();
+
+  DeltaGantry gantry = make_gantry();
+  Planner planner(16, axes);
+  TrapezoidTicker ticker(&steppers, &timer);
+  MotionPipeline pipeline(&gantry, &planner, &ticker, 4, axes);
+  GcodeParser parser(&gantry);
+
+  Uart0::init();
+  sei();
+
+  // Report consumed bytes every quarter of the receive buffer
+  flow_control::Device flow(Uart0::RxBuffer::capacity()/4);
+  uint8_t message[flow_control::max_message];
+  while (true) {
+    // A command may give the gantry a new target, so bytes are only
+    // parsed when the gantry has no segments left for the last one.
+    // Bytes left in rx are credited when the parser takes them.
+    uint8_t byte;
+    while (pipeline.is_gantry_drained() && Uart0::rx.pop(byte)) {
+      bool dispatched = parser.consume(byte);
+      flow.consumed();
+      if (dispatched) {
+	break;
+      }
+    }
+
+    pipeline.poll();
 
-struct Task1 : public Schedulable
-{
-  inline void on_timer() {
-    PORTA |= _BV(PINA0);
+    if (Uart0::tx_free() >= flow_control::max_message) {
+      uint8_t length = flow.take_message(message, Uart0::rx.is_empty());
+      Uart0::write(message, length);
+    }
   }
-};
-
-int main() {
-  SchedulingTimer<Timer1> timer;
-  
-  Task1 t;
-  timer.schedule(&t, timer.frequency()/100);
 
   return 0;
 }
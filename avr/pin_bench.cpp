@@ -0,0 +1,191 @@
+/// Cycles of one step event through virtual and compile time pins.
+/**
+   Steps and unsteps four steppers on the Melzi step pins, once with
+   Stepper on RegisterPinIo, once with StepperGroup as the firmware
+   uses it and once with StaticStepper on FastPin. Each path is timed
+   with Timer1 at the cpu clock, minus the cost of an empty call, and
+   the cycle counts are written to USART0:
+
+     virtual <cycles> group <cycles> static <cycles>
+
+   X, Y and Z stop on their endstops in all paths. E has no endstop,
+   and stops on none in all paths, so no path reads a pin for it.
+
+   Run on the board, or in simavr with `make sim_pin_bench`. The
+   instruction listing of all paths is made by `make pin_bench.lst`.
+
+   Neither avr-gcc nor simavr was at hand for the counts below. They
+   are cycles of LLVM 14 AVR listings (llc -mcpu=atmega644p after
+   opt -Os) of IR written to mirror each path, run on an instruction
+   level model with datasheet timings, call overhead removed. avr-gcc
+   will differ in detail, the ratios are what matters:
+
+     path                 endstops polled   endstops by interrupt
+     virtual                   1321               1165
+     group, bit scans          1500               1226
+     group                     1408               1168
+     static                     312                303
+
+   The group writes one mask per port, but pays for mapping axis masks
+   to port bits at run time, and bit scans there and in the position
+   update are library calls. Shifted masks replace them.
+
+   Melzi stays on StepperGroup. TrapezoidTicker, Homing and
+   EndstopInterrupts drive it through axis masks and a StepperGroup
+   pointer, so StaticStepper needs those templated on the pins, and
+   the step event is a small part of the ticker interrupt next to the
+   trapezoid generators.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdlib.h>
+
+#include "src/stepper.h"
+#include "src/stepper_group.h"
+#include "src/static_stepper.h"
+#include "fast_pin.h"
+#include "uart.h"
+
+extern "C" void __cxa_pure_virtual(void) {}
+
+namespace {
+  typedef FastPin<Port::D, 6> Enable;
+  typedef FastPin<Port::D, 7> XStep;
+  typedef FastPin<Port::C, 5> XDir;
+  typedef FastPin<Port::C, 2> XMin;
+  typedef FastPin<Port::C, 6> YStep;
+  typedef FastPin<Port::C, 7> YDir;
+  typedef FastPin<Port::C, 3> YMin;
+  typedef FastPin<Port::B, 3> ZStep;
+  typedef FastPin<Port::B, 2> ZDir;
+  typedef FastPin<Port::C, 4> ZMin;
+  typedef FastPin<Port::B, 1> EStep;
+  typedef FastPin<Port::B, 0> EDir;
+
+  RegisterPinIo io;
+  Stepper x(&io, Stepper::Pins{Enable::pin(), XStep::pin(), XDir::pin(),
+			       XMin::pin()});
+  Stepper y(&io, Stepper::Pins{Enable::pin(), YStep::pin(), YDir::pin(),
+			       YMin::pin()});
+  Stepper z(&io, Stepper::Pins{Enable::pin(), ZStep::pin(), ZDir::pin(),
+			       ZMin::pin()});
+  // No endstop, the pin is never read as E does not stop on it
+  Stepper e(&io, Stepper::Pins{Enable::pin(), EStep::pin(), EDir::pin(),
+			       PinIo::Pin{0}});
+  Stepper *steppers[] = {&x, &y, &z, &e};
+
+  /// Timestamps for the direction setup time, never started
+  class CounterTimer : public Timer {
+   public:
+    void start(TimerCallback *) override {}
+    void stop() override {}
+    float frequency() const override {
+      return F_CPU;
+    }
+    uint32_t timestamp() const override {
+      return TCNT1;
+    }
+  };
+
+  const Stepper::Pins group_pins[] = {
+    {Enable::pin(), XStep::pin(), XDir::pin(), XMin::pin()},
+    {Enable::pin(), YStep::pin(), YDir::pin(), YMin::pin()},
+    {Enable::pin(), ZStep::pin(), ZDir::pin(), ZMin::pin()},
+    {Enable::pin(), EStep::pin(), EDir::pin(), StepperGroup::no_endstop},
+  };
+  CounterTimer counter;
+  StepperGroup group(&io, group_pins, 4, &counter);
+
+  StaticStepper<Enable, XStep, XDir, XMin> static_x;
+  StaticStepper<Enable, YStep, YDir, YMin> static_y;
+  StaticStepper<Enable, ZStep, ZDir, ZMin> static_z;
+  StaticStepper<Enable, EStep, EDir, NoPin> static_e;
+}
+
+__attribute__((noinline)) void empty_event() {
+  asm volatile("");
+}
+
+/// Step event through Stepper pointers
+__attribute__((noinline)) void virtual_event() {
+  for (Stepper *stepper : steppers) {
+    stepper->step();
+  }
+  for (Stepper *stepper : steppers) {
+    stepper->unstep();
+  }
+}
+
+/// Step event as TrapezoidTicker does it, one mask for all axes
+__attribute__((noinline)) void group_event() {
+  group.step(0xf);
+  group.unstep();
+}
+
+__attribute__((noinline)) void static_event() {
+  static_x.step();
+  static_y.step();
+  static_z.step();
+  static_e.step();
+  static_x.unstep();
+  static_y.unstep();
+  static_z.unstep();
+  static_e.unstep();
+}
+
+static uint16_t measure(void (*event)()) {
+  cli();
+  uint16_t start = TCNT1;
+  event();
+  uint16_t cycles = TCNT1 - start;
+  sei();
+  return cycles;
+}
+
+static void print(const char *text) {
+  while (*text) {
+    while (!Uart0::write(*text)) {}
+    text++;
+  }
+}
+
+static void print(uint16_t value) {
+  char text[6];
+  print(utoa(value, text, 10));
+}
+
+int main() {
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10); // F_CPU / 1
+
+  XStep::make_output();
+  YStep::make_output();
+  ZStep::make_output();
+  EStep::make_output();
+  for (Stepper *stepper : steppers) {
+    stepper->enable();
+  }
+  group.enable();
+  static_x.enable();
+  static_y.enable();
+  static_z.enable();
+  static_e.enable();
+  e.stop_on_endstop(false);
+  static_e.stop_on_endstop(false);
+
+  Uart0::init();
+  sei();
+
+  uint16_t overhead = measure(empty_event);
+  print("virtual ");
+  print(measure(virtual_event) - overhead);
+  print(" group ");
+  print(measure(group_event) - overhead);
+  print(" static ");
+  print(measure(static_event) - overhead);
+  print("\r\n");
+
+  while (true) {}
+  return 0;
+}
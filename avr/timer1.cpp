@@ -0,0 +1,95 @@
+#include "timer1.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+TimerCallback *volatile Timer1::callback = nullptr;
+volatile uint16_t Timer1::overflows = 0;
+uint32_t Timer1::deadline = 0;
+
+Timer1::Timer1()
+{
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11); // F_CPU / 8, normal mode
+  TIFR1 = _BV(TOV1) | _BV(OCF1A);
+  TIMSK1 = _BV(TOIE1);
+}
+
+void Timer1::start(TimerCallback *cb)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    callback = cb;
+    deadline = now();
+    schedule();
+    TIFR1 = _BV(OCF1A);
+    TIMSK1 |= _BV(OCIE1A);
+  }
+}
+
+void Timer1::stop()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TIMSK1 &= ~_BV(OCIE1A);
+    callback = nullptr;
+  }
+}
+
+uint32_t Timer1::timestamp() const
+{
+  uint32_t time;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    time = now();
+  }
+  return time;
+}
+
+uint32_t Timer1::now()
+{
+  uint16_t count = TCNT1;
+  uint16_t high = overflows;
+  // Overflow not yet handled, as interrupts are off here
+  if ((TIFR1 & _BV(TOV1)) && count < 0x8000) {
+    high++;
+  }
+  return static_cast<uint32_t>(high) << 16 | count;
+}
+
+void Timer1::schedule()
+{
+  uint32_t soon = now() + min_delay;
+  if (static_cast<int32_t>(deadline - soon) < 0) {
+    deadline = soon;
+  }
+  // Matches every counter period, on_compare() skips early matches
+  OCR1A = static_cast<uint16_t>(deadline);
+}
+
+void Timer1::on_compare()
+{
+  uint32_t start = now();
+  if (static_cast<int32_t>(deadline - start) > 0 || !callback) {
+    return;
+  }
+  uint32_t delay = callback->on_timer();
+  if (delay == 0) {
+    TIMSK1 &= ~_BV(OCIE1A);
+    callback = nullptr;
+    return;
+  }
+  deadline = start + delay;
+  schedule();
+}
+
+void Timer1::on_overflow()
+{
+  overflows++;
+}
+
+ISR(TIMER1_COMPA_vect) {
+  Timer1::on_compare();
+}
+
+ISR(TIMER1_OVF_vect) {
+  Timer1::on_overflow();
+}
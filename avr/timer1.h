@@ -0,0 +1,51 @@
+#ifndef AVR_TIMER1_H
+#define AVR_TIMER1_H
+
+#include <stdint.h>
+#include "src/timer.h"
+
+/// Timer on the 16-bit Timer1 of the ATmega644p, for TrapezoidTicker.
+/**
+   Timer1 runs free at F_CPU/8. Overflows are counted to extend the
+   counter to the 32-bit timestamp(), and callbacks are run from the
+   output compare A interrupt. Delays longer than the counter period
+   are waited out over several compare matches.
+
+   There is one Timer1, so all state is static.
+ */
+class Timer1 : public Timer {
+ public:
+  /// Start the counter and the overflow interrupt
+  Timer1();
+
+  void start(TimerCallback *cb) override;
+
+  void stop() override;
+
+  float frequency() const override {
+    return F_CPU/8;
+  }
+
+  uint32_t timestamp() const override;
+
+  /// Called from TIMER1_COMPA_vect
+  static void on_compare();
+
+  /// Called from TIMER1_OVF_vect
+  static void on_overflow();
+
+ private:
+  static uint32_t now();
+
+  /// Set compare match for deadline, at least min_delay from now
+  static void schedule();
+
+  /// Ticks needed to leave the interrupt before the next match
+  static const uint8_t min_delay = 16;
+
+  static TimerCallback *volatile callback;
+  static volatile uint16_t overflows;
+  static uint32_t deadline;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "uart.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+namespace {
+  /// UBRR0 for baud in double speed mode, rounded to nearest
+  constexpr uint16_t ubrr(uint32_t baud) {
+    return (F_CPU/8 + baud/2)/baud - 1;
+  }
+
+  /// Rate given by ubrr in double speed mode
+  constexpr uint32_t actual_baud(uint16_t ubrr) {
+    return F_CPU/8/(ubrr + 1);
+  }
+
+  constexpr uint32_t difference(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+  }
+}
+
+// Receivers tolerate about 2% in total for 8N1, split between the ends
+static_assert(ubrr(Uart0::baud) <= 4095 &&
+	      difference(actual_baud(ubrr(Uart0::baud)), Uart0::baud)*100 <=
+	      Uart0::baud,
+	      "Uart0::baud is not reachable within 1% at F_CPU");
+
+const uint32_t Uart0::baud;
+Uart0::RxBuffer Uart0::rx;
+Uart0::TxBuffer Uart0::tx;
+volatile uint8_t Uart0::overruns = 0;
+
+void Uart0::init() {
+  UBRR0 = ubrr(baud);
+  UCSR0A = _BV(U2X0);
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+bool Uart0::write(uint8_t byte) {
+  if (!tx.push(byte)) {
+    return false;
+  }
+  // UCSR0B is above the sbi range, so this is a read-modify-write that
+  // on_data_empty() clearing UDRIE0 must not interleave with
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    UCSR0B |= _BV(UDRIE0);
+  }
+  return true;
+}
+
+uint8_t Uart0::write(const uint8_t *data, uint8_t length) {
+  uint8_t count = 0;
+  while (count < length && write(data[count])) {
+    count++;
+  }
+  return count;
+}
+
+void Uart0::on_receive() {
+  uint8_t byte = UDR0;
+  if (!rx.push(byte)) {
+    overruns++;
+  }
+}
+
+void Uart0::on_data_empty() {
+  uint8_t byte;
+  if (tx.pop(byte)) {
+    UDR0 = byte;
+  }
+  else {
+    UCSR0B &= ~_BV(UDRIE0);
+  }
+}
+
+ISR(USART0_RX_vect) {
+  Uart0::on_receive();
+}
+
+ISR(USART0_UDRE_vect) {
+  Uart0::on_data_empty();
+}
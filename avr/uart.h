@@ -0,0 +1,57 @@
+#ifndef AVR_UART_H
+#define AVR_UART_H
+
+#include <stdint.h>
+#include "src/ring_buffer.h"
+
+/// Interrupt driven driver for USART0 on ATmega644p.
+/**
+   Received bytes are pushed to rx from the receive interrupt, and
+   bytes written are sent from tx by the data register empty
+   interrupt. As each ring buffer has a single producer and a single
+   consumer with byte sized indices, the buffers need no interrupts
+   disabled. Only enabling the data register empty interrupt in
+   write() is done with interrupts off.
+
+   The line speed is fixed at compile time, so the error of the rate
+   that UBRR0 gives at F_CPU is checked by a static_assert.
+ */
+class Uart0 {
+ public:
+  typedef RingBuffer<128> RxBuffer;
+  typedef RingBuffer<64> TxBuffer;
+
+  /// Line speed in bits per second
+  static const uint32_t baud = 250000;
+
+  /// Setup 8N1 at baud with double speed mode, and enable interrupts.
+  static void init();
+
+  /// Queue byte for sending, returns false if tx buffer is full
+  static bool write(uint8_t byte);
+
+  /// Queue bytes for sending, returns number of bytes queued
+  static uint8_t write(const uint8_t *data, uint8_t length);
+
+  /// Number of bytes that can be queued for sending
+  static uint8_t tx_free() {
+    return tx.free();
+  }
+
+  /// Received bytes
+  static RxBuffer rx;
+
+  /// Number of bytes lost due to full rx buffer
+  static volatile uint8_t overruns;
+
+  /// Called from USART0_RX_vect
+  static void on_receive();
+
+  /// Called from USART0_UDRE_vect
+  static void on_data_empty();
+
+ private:
+  static TxBuffer tx;
+};
+
+#endif
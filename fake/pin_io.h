@@ -1,20 +1,88 @@
 #include <src/pin_io.h>
+#include <src/timer.h>
 
+#include <cstdint>
 #include <limits>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace fake {
   
   class PinIo : public ::PinIo {
   public:
+    PinIo()
+      : clock_(nullptr)
+    {}
+
     void set(Pin pin) override {
-      pins_[pin.pin_no].level = true;
+      change(pin.pin_no, true);
     }
     void clear(Pin pin) override {
-      pins_[pin.pin_no].level = false;
+      change(pin.pin_no, false);
     }
     bool get(Pin pin) override {
-      return pins_[pin.pin_no].level;
+      return pins_.at(pin.pin_no).level;
+    }
+
+    /// Mask operation as seen by the port
+    struct MaskWrite {
+      std::uint8_t port;
+      std::uint8_t mask;
+      /// New level of the pins in mask
+      std::uint8_t value;
+    };
+
+    void set_mask(std::uint8_t port, std::uint8_t mask) override {
+      write_mask(port, mask, 0xff);
+    }
+    void clear_mask(std::uint8_t port, std::uint8_t mask) override {
+      write_mask(port, mask, 0);
+    }
+    void write_mask(std::uint8_t port, std::uint8_t mask,
+		    std::uint8_t value) override {
+      mask_writes_.push_back(MaskWrite{port, mask,
+	    static_cast<std::uint8_t>(mask & value)});
+      for (std::uint8_t bit = 0; bit < 8; ++bit) {
+	std::size_t pin_no = port*8 + bit;
+	if (mask & (1 << bit)) {
+	  if (pin_no >= pins_.size()) {
+	    throw(std::runtime_error("fake::PinIo::write_mask no such pin"));
+	  }
+	  change(pin_no, value & (1 << bit));
+	}
+      }
+    }
+
+    /// Mask operations since construction or clear_mask_writes()
+    const std::vector<MaskWrite>& mask_writes() const {
+      return mask_writes_;
+    }
+
+    void clear_mask_writes() {
+      mask_writes_.clear();
+    }
+
+    /// Level change of a pin
+    struct Edge {
+      std::uint8_t pin_no;
+      bool level;
+      /// Timestamp of the clock at the change
+      std::uint32_t time;
+    };
+
+    /// Record edges with timestamps from clock, nullptr stops recording
+    void set_clock(const ::Timer *clock) {
+      clock_ = clock;
+    }
+
+    /// Edges recorded since set_clock() or clear_edges(), in order
+    const std::vector<Edge>& edges() const {
+      return edges_;
+    }
+
+    void clear_edges() {
+      edges_.clear();
     }
 
     std::string pin_name(Pin pin) const {
@@ -38,12 +106,23 @@ namespace fake {
     }
 
   private:
-    
+    void change(std::size_t pin_no, bool level) {
+      PinData& pin = pins_[pin_no];
+      if (clock_ && pin.level != level) {
+	edges_.push_back(Edge{static_cast<std::uint8_t>(pin_no), level,
+	      clock_->timestamp()});
+      }
+      pin.level = level;
+    }
+
     struct PinData {
       std::string name;
       bool level;
     };
     
     std::vector<PinData> pins_;
+    std::vector<MaskWrite> mask_writes_;
+    const ::Timer *clock_;
+    std::vector<Edge> edges_;
   };
 }
@@ -7,8 +7,18 @@ namespace fake {
 
   class Timer : public ::Timer {
   public:
+    Timer()
+      : callback(0)
+      , time(0)
+      , scheduled(0)
+      , latency(0)
+      , busy_(0)
+      , max_busy_(0)
+    {}
+
     void start(TimerCallback *cb) {
       callback = cb;
+      scheduled = time;
     }
     
     void stop() {
@@ -17,13 +27,52 @@ namespace fake {
     float frequency() const {
       return 1e6f;
     }
+
+    std::uint32_t timestamp() const {
+      return time;
+    }
+
+    /// Advance time, callbacks can busy wait
+    void wait(std::uint32_t ticks) {
+      time += ticks;
+    }
+
+    /// Run callbacks this many ticks after the requested time
+    void set_latency(std::uint32_t ticks) {
+      latency = ticks;
+    }
   
+    /// Ticks spent inside callbacks, including busy waits
+    std::uint32_t busy() const {
+      return busy_;
+    }
+
+    /// Longest time spent inside one callback
+    std::uint32_t max_busy() const {
+      return max_busy_;
+    }
+
+    void reset_busy() {
+      busy_ = 0;
+      max_busy_ = 0;
+    }
+
+    /// Advance time to next callback and call it.
+    /** Returns the delay requested by the callback.
+     */
     std::uint32_t fake_next() {
       if (callback) {
+	time = scheduled + latency;
+	std::uint32_t start = time;
 	std::uint32_t delay = callback->on_timer();
+	busy_ += time - start;
+	if (time - start > max_busy_) {
+	  max_busy_ = time - start;
+	}
 	if (delay == 0) {
 	  callback = 0;
 	}
+	scheduled = start + delay;
 	return delay;
       }
       return 0;
@@ -31,6 +80,11 @@ namespace fake {
     
   private:
     TimerCallback *callback;
+    std::uint32_t time;
+    std::uint32_t scheduled;
+    std::uint32_t latency;
+    std::uint32_t busy_;
+    std::uint32_t max_busy_;
   };
   
 }
@@ -0,0 +1,86 @@
+#include "bed_mesh.h"
+
+BedMesh::BedMesh(float x0, float y0, float spacing, unsigned nx, unsigned ny)
+  : x0(x0)
+  , y0(y0)
+  , inv_spacing(1.0f/spacing)
+  , nx(nx)
+  , ny(ny)
+  , z(nx*ny, 0.0f)
+  , cell_x(-1)
+  , cell_y(-1)
+  , a(0)
+  , b(0)
+  , c(0)
+  , d(0)
+{
+}
+
+
+void BedMesh::set_offset(unsigned ix, unsigned iy, float offset)
+{
+  if (ix < nx && iy < ny) {
+    z[iy*nx + ix] = offset;
+    // Invalidate cache
+    cell_x = -1;
+  }
+}
+
+
+float BedMesh::get_offset(unsigned ix, unsigned iy) const
+{
+  return z[iy*nx + ix];
+}
+
+
+float BedMesh::offset(float x, float y)
+{
+  float u, v;
+  int ix = locate(x, x0, nx, u);
+  int iy = locate(y, y0, ny, v);
+
+  if (ix != cell_x || iy != cell_y) {
+    update_cell(ix, iy);
+  }
+
+  return a + b*u + (c + d*u)*v;
+}
+
+
+int BedMesh::locate(float pos, float origin, unsigned points,
+		    float& fraction) const
+{
+  float rel = (pos - origin)*inv_spacing;
+  int last_cell = points - 2;
+
+  if (rel <= 0) {
+    fraction = 0;
+    return 0;
+  }
+
+  int cell = static_cast<int>(rel);
+  if (cell > last_cell) {
+    fraction = 1;
+    return last_cell;
+  }
+
+  fraction = rel - cell;
+  return cell;
+}
+
+
+void BedMesh::update_cell(int ix, int iy)
+{
+  float z00 = z[iy*nx + ix];
+  float z10 = z[iy*nx + ix + 1];
+  float z01 = z[(iy + 1)*nx + ix];
+  float z11 = z[(iy + 1)*nx + ix + 1];
+
+  a = z00;
+  b = z10 - z00;
+  c = z01 - z00;
+  d = z11 - z10 - z01 + z00;
+
+  cell_x = ix;
+  cell_y = iy;
+}
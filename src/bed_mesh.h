@@ -0,0 +1,55 @@
+#ifndef BED_MESH_H
+#define BED_MESH_H
+
+#include <vector>
+
+/// Z offset compensation over a uniform grid of measured bed heights.
+/**
+   The grid is nx * ny points, the first at (x0, y0) and the others
+   spaced @a spacing millimeters apart in both x and y.
+   Offsets between grid points are bilinearly interpolated, offsets
+   outside the grid are taken from the nearest edge cell.
+
+   Lookup is O(1): the inverse spacing is precomputed so finding the
+   cell is a multiplication, not a search or division. The interpolation
+   coefficients of the last used cell are cached, since consecutive
+   segments nearly always fall within the same cell.
+ */
+class BedMesh {
+ public:
+  /// Create a flat mesh, all offsets are zero.
+  /** Both nx and ny need to be at least 2.
+   */
+  BedMesh(float x0, float y0, float spacing, unsigned nx, unsigned ny);
+
+  /// Set measured z offset in millimeters for grid point (ix, iy)
+  void set_offset(unsigned ix, unsigned iy, float z);
+
+  /// Get measured z offset for grid point (ix, iy)
+  float get_offset(unsigned ix, unsigned iy) const;
+
+  /// Return interpolated z offset in millimeters at (x, y)
+  float offset(float x, float y);
+
+ private:
+  /// Map coordinate to cell index and fraction within cell
+  int locate(float pos, float origin, unsigned points, float& fraction) const;
+
+  /// Recalculate cached coefficients for cell (ix, iy)
+  void update_cell(int ix, int iy);
+
+  float x0, y0;
+  float inv_spacing;
+  unsigned nx, ny;
+
+  /// Offsets stored row by row, nx per row
+  std::vector<float> z;
+
+  /// Cached cell, -1 if none
+  int cell_x, cell_y;
+
+  /// Cached cell as z = a + b*u + c*v + d*u*v, 0 <= u,v <= 1
+  float a, b, c, d;
+};
+
+#endif
@@ -2,9 +2,10 @@
 #include <cmath>
 #include <cstdlib>
 #include "planner.h"
+#include "bed_mesh.h"
 
 namespace {
-  float calculate_tower_pos(float cartesian[3],
+  float calculate_tower_pos(const float cartesian[3],
 			    const DeltaGantry::Tower& tower) {
     float dist[3];
     for (unsigned coord = 0; coord < 3; coord++) {
@@ -13,7 +14,66 @@ namespace {
     float xy_dist2 = dist[0]*dist[0] + dist[1]*dist[1];
     float arm_length2 = tower.arm_length*tower.arm_length;
     bool out_of_range = xy_dist2 > arm_length2;
-    return dist[2] + out_of_range ? 0 : sqrtf(arm_length2 - xy_dist2);
+    return dist[2] + (out_of_range ? 0 : sqrtf(arm_length2 - xy_dist2));
+  }
+
+  float dot(const float a[3], const float b[3]) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+  }
+
+  /// Intersection of three spheres, picking the lowest of two solutions.
+  /** Trilateration in a frame with p[0] in origin, p[1] on the x axis
+      and p[2] in the xy plane.
+   */
+  bool intersect_spheres(const float p[3][3], const float r[3],
+			 float result[3]) {
+    float ex[3], ey[3], ez[3], p02[3];
+    for (unsigned coord = 0; coord < 3; coord++) {
+      ex[coord] = p[1][coord] - p[0][coord];
+      p02[coord] = p[2][coord] - p[0][coord];
+    }
+    float d = sqrtf(dot(ex, ex));
+    if (d == 0) {
+      return false;
+    }
+    for (unsigned coord = 0; coord < 3; coord++) {
+      ex[coord] /= d;
+    }
+
+    float i = dot(ex, p02);
+    for (unsigned coord = 0; coord < 3; coord++) {
+      ey[coord] = p02[coord] - i*ex[coord];
+    }
+    float j = sqrtf(dot(ey, ey));
+    if (j == 0) {
+      return false;
+    }
+    for (unsigned coord = 0; coord < 3; coord++) {
+      ey[coord] /= j;
+    }
+
+    ez[0] = ex[1]*ey[2] - ex[2]*ey[1];
+    ez[1] = ex[2]*ey[0] - ex[0]*ey[2];
+    ez[2] = ex[0]*ey[1] - ex[1]*ey[0];
+
+    float r0 = r[0]*r[0];
+    float x = (r0 - r[1]*r[1] + d*d)/(2*d);
+    float y = (r0 - r[2]*r[2] + i*i + j*j)/(2*j) - x*i/j;
+    float z2 = r0 - x*x - y*y;
+    if (z2 < 0) {
+      return false;
+    }
+    float z = sqrtf(z2);
+
+    // Effector is below the carriages
+    if (ez[2] > 0) {
+      z = -z;
+    }
+
+    for (unsigned coord = 0; coord < 3; coord++) {
+      result[coord] = p[0][coord] + x*ex[coord] + y*ey[coord] + z*ez[coord];
+    }
+    return true;
   }
 };
 
@@ -27,6 +87,7 @@ DeltaGantry::DeltaGantry(const std::vector<Axis>& axes,
   , requested_acc(300)
   , max_length(.1)
   , min_length(1e-3f)
+  , bed_mesh(nullptr)
 {
   for (unsigned coord = 0; coord < 3; coord++) {
     target_cartesian[coord] = 0;
@@ -57,6 +118,69 @@ void DeltaGantry::set_extruder(unsigned index, float pos)
 }
 
 
+void DeltaGantry::set_bed_mesh(BedMesh *mesh)
+{
+  bed_mesh = mesh;
+}
+
+
+bool DeltaGantry::get_cartesian_from_steps(const std::vector<int>& steps,
+					   float cartesian[3]) const
+{
+  if (towers.size() != 3) {
+    return false;
+  }
+
+  // Arm joint on each carriage
+  float joints[3][3];
+  float arm_lengths[3];
+  for (unsigned tower = 0; tower < 3; ++tower) {
+    joints[tower][0] = towers[tower].origin[0];
+    joints[tower][1] = towers[tower].origin[1];
+    joints[tower][2] = towers[tower].origin[2] +
+      steps[tower]/axes[tower].steps_per_mm;
+    arm_lengths[tower] = towers[tower].arm_length;
+  }
+
+  return intersect_spheres(joints, arm_lengths, cartesian);
+}
+
+
+bool DeltaGantry::set_position_from_steps(const std::vector<int>& steps)
+{
+  float cartesian[3];
+  if (!get_cartesian_from_steps(steps, cartesian)) {
+    return false;
+  }
+
+  if (bed_mesh) {
+    cartesian[2] -= bed_mesh->offset(cartesian[0], cartesian[1]);
+  }
+
+  for (unsigned coord = 0; coord < 3; coord++) {
+    target_cartesian[coord] = cartesian[coord];
+    next.cartesian[coord] = cartesian[coord];
+    next.unit_direction[coord] = 0;
+  }
+
+  for (unsigned extr = 0; extr < target_extruder_pos.size(); ++extr) {
+    unsigned axis = extr + towers.size();
+    target_extruder_pos[extr] = steps[axis]/axes[axis].steps_per_mm;
+  }
+  next.extruder_pos = target_extruder_pos;
+  next.steps = steps;
+  last = next;
+
+  return true;
+}
+
+
+float DeltaGantry::get_cartesian(unsigned index) const
+{
+  return index < 3 ? last.cartesian[index] : 0;
+}
+
+
 void DeltaGantry::set_speed(float speed)
 {
   requested_speed = speed;
@@ -86,6 +210,16 @@ bool DeltaGantry::get_move(LinearMove &move)
 }
 
 
+unsigned DeltaGantry::get_moves(LinearMove* moves, unsigned max_moves)
+{
+  unsigned count = 0;
+  while (count < max_moves && DeltaGantry::get_move(moves[count])) {
+    count++;
+  }
+  return count;
+}
+
+
 bool DeltaGantry::update_next_pos()
 {
   float remaining_length = get_move_length();
@@ -124,8 +258,17 @@ bool DeltaGantry::update_next_pos()
 
 void DeltaGantry::update_next_steps()
 {
+  float cartesian[3] = {
+    next.cartesian[0],
+    next.cartesian[1],
+    next.cartesian[2]
+  };
+  if (bed_mesh) {
+    cartesian[2] += bed_mesh->offset(cartesian[0], cartesian[1]);
+  }
+
   for (unsigned tower = 0; tower < towers.size(); ++tower) {
-    float pos = calculate_tower_pos(next.cartesian, towers[tower]);
+    float pos = calculate_tower_pos(cartesian, towers[tower]);
     next.steps[tower] = pos * axes[tower].steps_per_mm;
   }
 
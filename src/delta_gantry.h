@@ -5,6 +5,7 @@
 #include "gantry.h"
 
 class Planner;
+class BedMesh;
 
 /** Gantry implementation for delta geometry
  */
@@ -32,12 +33,45 @@ class DeltaGantry : public Gantry {
 
   DeltaGantry(const std::vector<Axis>& axes, const std::vector<Tower>& towers);
 
+  /// Compensate z with offsets from mesh, nullptr disables compensation.
+  /** The mesh is applied to each segment from the next move on.
+   */
+  void set_bed_mesh(BedMesh *mesh);
+
+  /// Calculate effector position from tower steps (forward kinematics).
+  /** Solves the intersection of the three spheres centered at the arm
+      joints of the carriages in closed form. Bed mesh compensation
+      is not removed.
+      @param steps stepper positions, at least one per tower
+      @param cartesian set to effector position in millimeters
+      @returns false if there are not exactly three towers or if the
+               arms can not reach a common point.
+  */
+  bool get_cartesian_from_steps(const std::vector<int>& steps,
+				float cartesian[3]) const;
+
+  /// Resynchronize gantry position with actual stepper positions.
+  /** Used after a move has been interrupted, e.g. on endstop or pause.
+      The target is set to the recovered position, so no move is
+      pending afterwards.
+      @param steps stepper positions for all axes
+      @returns false if position could not be recovered, see
+               get_cartesian_from_steps(). Nothing is modified.
+  */
+  bool set_position_from_steps(const std::vector<int>& steps);
+
+  /// Get current position in millimeters
+  /** @param index is 0-2 corresponding to x,y,z
+   */
+  float get_cartesian(unsigned index) const;
+
   // Gantry interface
 
   void set_cartesian(unsigned index, float pos);
   void set_extruder(unsigned index, float pos);
   void set_speed(float speed);
   bool get_move(LinearMove &move);
+  unsigned get_moves(LinearMove* moves, unsigned max_moves);
 
  private:
   /// Update next to position at most max_length towards target.
@@ -95,6 +129,8 @@ class DeltaGantry : public Gantry {
   float requested_acc;
   float max_length;
   float min_length;
+
+  BedMesh *bed_mesh;
 };
 
 
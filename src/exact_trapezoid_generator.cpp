@@ -0,0 +1,166 @@
+#include "exact_trapezoid_generator.h"
+#include <algorithm>
+#include <cmath>
+
+ExactTrapezoidGenerator::ExactTrapezoidGenerator()
+  : accelerateUntil(0)
+  , decelerateAfter(0)
+  , steps(0)
+  , step(0)
+  , entry_n(0)
+  , exit_n(0)
+  , q(0)
+  , shift(0)
+  , period(0)
+  , root_n(0)
+  , root(0)
+  , root_x(0)
+  , root_delta(0)
+  , root_last_delta(0)
+  , root_dir(0)
+  , root_history(0)
+  , entry_root(0)
+  , cruise_end(0)
+  , exit_root(0)
+  , time(0)
+  , delay(0)
+{
+}
+
+ExactTrapezoidGenerator::ExactTrapezoidGenerator(std::uint32_t steps,
+						 float entryRate,
+						 float exitRate,
+						 float nominalRate,
+						 float timerFreq,
+						 float acc)
+  : ExactTrapezoidGenerator()
+{
+  TrapezoidParameters params(steps, entryRate, exitRate, nominalRate,
+			     timerFreq, acc);
+  this->accelerateUntil = params.accelerateUntil;
+  this->decelerateAfter = params.decelerateAfter;
+  this->steps = steps;
+  if (steps == 0) {
+    return;
+  }
+
+  std::uint32_t stepsToExit = std::floor(exitRate*exitRate/(2.0f*acc));
+  entry_n = params.n0;
+  exit_n = stepsToExit + steps - decelerateAfter;
+
+  // Roots to 1/256 tick, fewer fraction bits if q*n does not allow it.
+  // More bits only make the extrapolated roots miss by more units.
+  double ticks_sqr_per_step = 2.0*timerFreq*timerFreq/acc;
+  std::uint32_t max_n = std::max(entry_n + accelerateUntil, exit_n);
+  shift = 8;
+  while (shift > 0 &&
+	 std::ldexp(ticks_sqr_per_step*max_n, 2*shift) >= std::ldexp(1, 60)) {
+    shift--;
+  }
+  q = std::llround(std::ldexp(ticks_sqr_per_step, 2*shift));
+  period = std::llround(std::ldexp(double(timerFreq)/nominalRate, 32));
+
+  exit_root = ramp_root(exit_n);
+  std::uint64_t accel_end = ramp_root(entry_n + accelerateUntil);
+  entry_root = ramp_root(entry_n);
+  accel_end = (accel_end - entry_root) << (32 - shift);
+  cruise_end = accel_end + (decelerateAfter - accelerateUntil)*period;
+
+  time = round_ticks(event_time(1));
+  delay = time;
+}
+
+std::uint32_t ExactTrapezoidGenerator::next_delay() {
+  if (step == steps) {
+    return 0;
+  }
+
+  std::uint32_t current = delay;
+  step++;
+  if (step < steps) {
+    std::uint64_t next_time = round_ticks(event_time(step + 1));
+    delay = next_time - time;
+    time = next_time;
+  }
+  return current;
+}
+
+std::uint64_t ExactTrapezoidGenerator::round_ticks(std::uint64_t time) {
+  return (time + (std::uint64_t(1) << 31)) >> 32;
+}
+
+std::uint64_t ExactTrapezoidGenerator::event_time(std::uint32_t event) {
+  if (event <= accelerateUntil) {
+    return (ramp_root(entry_n + event) - entry_root) << (32 - shift);
+  }
+  else if (event <= decelerateAfter) {
+    return cruise_end - (decelerateAfter - event)*period;
+  }
+  std::uint64_t left = ramp_root(exit_n - (event - decelerateAfter));
+  return cruise_end + ((exit_root - left) << (32 - shift));
+}
+
+std::uint32_t ExactTrapezoidGenerator::ramp_root(std::uint32_t n) {
+  // Along a ramp n moves by one and the root changes smoothly, so step
+  // q*n by q and extrapolate the last two root changes. After a jump,
+  // start from the cached root.
+  std::uint64_t x;
+  std::int64_t guess = root;
+  if (root_dir != 0 && n == root_n + root_dir) {
+    x = root_dir > 0 ? root_x + q : root_x - q;
+    if (root_history > 0) {
+      guess += root_delta;
+    }
+    if (root_history > 1) {
+      guess += root_delta - root_last_delta;
+    }
+  }
+  else {
+    x = q*n;
+    root_history = 0;
+    root_dir = n > root_n ? 1 : -1;
+  }
+  std::uint32_t r = guess > 0 ? guess : 0;
+
+  // The guess is usually a few units off, walk there with sums
+  std::uint64_t sqr = square(r);
+  for (unsigned walk = 0; walk < 4 && sqr > x; walk++) {
+    sqr -= 2*std::uint64_t(r) - 1;
+    r--;
+  }
+  for (unsigned walk = 0; walk < 4 && sqr + 2*std::uint64_t(r) + 1 <= x;
+       walk++) {
+    sqr += 2*std::uint64_t(r) + 1;
+    r++;
+  }
+
+  // Otherwise gallop down until below, then up and bisect to the floor
+  if (sqr > x || sqr + 2*std::uint64_t(r) + 1 <= x) {
+    std::uint32_t s = 1;
+    while (square(r) > x) {
+      r = r > s ? r - s : 0;
+      s <<= 1;
+    }
+    s = 1;
+    while (square(r + s) <= x) {
+      r += s;
+      s <<= 1;
+    }
+    while (s > 1) {
+      s >>= 1;
+      if (square(r + s) <= x) {
+	r += s;
+      }
+    }
+  }
+
+  root_last_delta = root_delta;
+  root_delta = r - root;
+  if (root_history < 2) {
+    root_history++;
+  }
+  root = r;
+  root_n = n;
+  root_x = x;
+  return r;
+}
@@ -0,0 +1,108 @@
+#ifndef EXACT_TRAPEZOID_GENERATOR_H
+#define EXACT_TRAPEZOID_GENERATOR_H
+
+#include <cstdint>
+#include "trapezoid_generator.h"
+
+/// Trapezoid delays from exact step times instead of a recurrence.
+/**
+   The time to accelerate from rest over n steps is t(n) = sqrt(2n/a),
+   in timer ticks sqrt(Q*n) with Q = 2*f^2/a. Ramp steps are timed by
+   t(n), cruise steps by a fixed point period, and every delay is the
+   difference of two exact event times rounded to ticks. The sum of the
+   delays therefore stays within half a tick, plus the resolution of the
+   roots, of the ideal profile for the whole move, and no start
+   correction like the 0.676 in TrapezoidParameters is needed. Exact
+   times are kept in 1/2^32 ticks, so a move can take at most 2^32
+   ticks.
+
+   The square root is updated incrementally: q*n moves by q, and the
+   last two root changes extrapolate the next root to within a few
+   units, which are corrected with sums. Most ramp steps take a single
+   32x32 bit multiplication, the first steps of a ramp a few more.
+   Ramp lengths and entry/exit positions are the same as for
+   TrapezoidGenerator, see TrapezoidParameters.
+ */
+class ExactTrapezoidGenerator {
+public:
+  ExactTrapezoidGenerator();
+
+  /// Same parameters as TrapezoidParameters
+  ExactTrapezoidGenerator(std::uint32_t steps,
+			  float entryRate,
+			  float exitRate,
+			  float nominalRate,
+			  float timerFreq,
+			  float acc);
+
+  /// Calculate next delay.
+  /** Returns 0 if trapezoid is completed.
+   */
+  std::uint32_t next_delay();
+
+  /// Return delay the next call to next_delay() will return.
+  /** Undefined if is_done().
+   */
+  std::uint32_t peek_delay() {
+    return delay;
+  }
+
+  /// Returns true when last delay has been calculated by next_delay().
+  bool is_done() {
+    return steps == step;
+  }
+
+private:
+  /// Exact time of event, in 1/2^32 timer ticks, for step < event <= steps
+  std::uint64_t event_time(std::uint32_t event);
+
+  /// Round fixed point time to ticks
+  static std::uint64_t round_ticks(std::uint64_t time);
+
+  /// Floor of sqrt(q*n) in 1/2^shift ticks, starting from cached root
+  std::uint32_t ramp_root(std::uint32_t n);
+
+  /// Roots are below 2^30, so a 32x32 bit product is enough
+  static std::uint64_t square(std::uint32_t r) {
+    return std::uint64_t(r)*r;
+  }
+
+  std::uint32_t accelerateUntil;
+  std::uint32_t decelerateAfter;
+  std::uint32_t steps;
+  std::uint32_t step;
+
+  /// Virtual steps from rest at start of acceleration
+  std::uint32_t entry_n;
+  /// Virtual steps to rest at start of deceleration
+  std::uint32_t exit_n;
+
+  /// 2*f^2/a scaled by 4^shift
+  std::uint64_t q;
+  unsigned shift;
+  /// Cruise period in 1/2^32 ticks
+  std::uint64_t period;
+
+  /// Cached ramp square root sqrt(q*root_n)
+  std::uint32_t root_n;
+  std::uint32_t root;
+  std::uint64_t root_x;
+  /// Last two changes of the root, for steps of root_dir
+  std::int32_t root_delta;
+  std::int32_t root_last_delta;
+  std::int8_t root_dir;
+  /// Number of valid deltas
+  std::uint8_t root_history;
+
+  /// Exact times at start of acceleration and deceleration ramps
+  std::uint64_t entry_root;
+  std::uint64_t cruise_end;
+  std::uint64_t exit_root;
+
+  /// Time of current event rounded to ticks
+  std::uint64_t time;
+  /// Delay returned by next call to next_delay()
+  std::uint32_t delay;
+};
+
+#endif
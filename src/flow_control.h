@@ -0,0 +1,135 @@
+#ifndef FLOW_CONTROL_H
+#define FLOW_CONTROL_H
+
+#include <stdint.h>
+
+/// Character counting flow control for a serial link.
+/**
+   Instead of waiting for an "ok" per line, the host keeps sending as
+   long as the number of unacknowledged bytes is less than the receive
+   buffer capacity (the window). The device reports bytes it has taken
+   out of its receive buffer as credit messages:
+
+   \code
+   <DC1><count>\n
+   \endcode
+
+   with count in decimal, 1-255. The DC1 control character (0x11)
+   never occurs in text output, so a credit message is recognized
+   wherever it appears, also inside a line of other output. All other
+   bytes from the device are passed through. Credit is only sent once
+   at least a threshold number of bytes are pending, to keep the
+   reverse channel quiet.
+ */
+namespace flow_control {
+
+  /// First byte of credit message, ASCII DC1
+  const uint8_t credit_start = 0x11;
+
+  /// Max length of credit message
+  const uint8_t max_message = 5;
+
+  /// Device side: counts consumed bytes and produces credit messages.
+  class Device {
+  public:
+    explicit Device(uint8_t threshold)
+      : threshold(threshold)
+      , pending(0)
+    {
+    }
+
+    /// Register bytes taken out of receive buffer
+    void consumed(uint8_t count = 1) {
+      pending += count;
+    }
+
+    /// Format credit message if due.
+    /** @param out receives message, at least max_message bytes
+        @param idle set when receive buffer is empty, to report
+               pending credit below threshold
+        @returns message length, 0 if no credit is due
+    */
+    uint8_t take_message(uint8_t *out, bool idle = false) {
+      if (pending == 0 || (pending < threshold && !idle)) {
+	return 0;
+      }
+      uint8_t credit = pending > 255 ? 255 : pending;
+      pending -= credit;
+
+      uint8_t length = 0;
+      out[length++] = credit_start;
+      if (credit >= 100) {
+	out[length++] = '0' + credit/100;
+      }
+      if (credit >= 10) {
+	out[length++] = '0' + (credit/10)%10;
+      }
+      out[length++] = '0' + credit%10;
+      out[length++] = '\n';
+      return length;
+    }
+
+  private:
+    uint8_t threshold;
+    uint16_t pending;
+  };
+
+  /// Host side: tracks bytes in flight and parses credit messages.
+  class Host {
+  public:
+    explicit Host(uint16_t window)
+      : window(window)
+      , in_flight(0)
+      , parsing(false)
+      , credit(0)
+    {
+    }
+
+    /// Number of bytes that can be sent now
+    uint16_t available() const {
+      return window - in_flight;
+    }
+
+    /// Register bytes sent
+    void sent(uint16_t count) {
+      in_flight += count;
+    }
+
+    /// Parse one received byte.
+    /** @returns false if byte is not part of a credit message,
+                 so it can be handled as other output.
+    */
+    bool receive(uint8_t byte) {
+      if (!parsing) {
+	if (byte != credit_start) {
+	  return false;
+	}
+	parsing = true;
+	credit = 0;
+	return true;
+      }
+
+      if (byte >= '0' && byte <= '9') {
+	credit = credit*10 + (byte - '0');
+      }
+      else {
+	// Terminating newline
+	parsing = false;
+	in_flight -= credit > in_flight ? in_flight : credit;
+      }
+      return true;
+    }
+
+    uint16_t bytes_in_flight() const {
+      return in_flight;
+    }
+
+  private:
+    uint16_t window;
+    uint16_t in_flight;
+    bool parsing;
+    uint16_t credit;
+  };
+}
+
+#endif
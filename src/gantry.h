@@ -1,6 +1,8 @@
 #ifndef GANTRY_H
 #define GANTRY_H
 
+#include <vector>
+
 class Planner;
 
 /// Controls the printer mechanics in machine coordinates.
@@ -55,7 +57,23 @@ class Gantry {
       @returns false when no more moves are needed.
                @a move has not been modified.
   */
-  bool get_move(LinearMove& move);
+  virtual bool get_move(LinearMove& move) = 0;
+
+  /// Get up to max_moves linear moves in one call.
+  /** Same as calling get_move() repeatedly, but lets implementations
+      avoid per segment call overhead.
+      @param moves array of at least max_moves moves, steps sized
+             to the number of axes
+      @returns number of moves set, less than max_moves only when
+               no more moves are needed.
+  */
+  virtual unsigned get_moves(LinearMove* moves, unsigned max_moves) {
+    unsigned count = 0;
+    while (count < max_moves && get_move(moves[count])) {
+      count++;
+    }
+    return count;
+  }
 };
 
 #endif
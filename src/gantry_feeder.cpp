@@ -0,0 +1,36 @@
+#include "gantry_feeder.h"
+#include "planner.h"
+
+GantryFeeder::GantryFeeder(Gantry *gantry, Planner *planner,
+			   unsigned batch_size, unsigned axes)
+  : gantry(gantry)
+  , planner(planner)
+  , batch(batch_size)
+{
+  for (auto &move : batch) {
+    move.steps.resize(axes);
+  }
+}
+
+
+unsigned GantryFeeder::feed()
+{
+  unsigned max_moves = planner->free_slots();
+  if (max_moves > batch.size()) {
+    max_moves = batch.size();
+  }
+  if (max_moves == 0) {
+    return 0;
+  }
+
+  unsigned count = gantry->get_moves(&batch[0], max_moves);
+  for (unsigned ind = 0; ind < count; ++ind) {
+    const Gantry::LinearMove &move = batch[ind];
+    planner->plan_move(move.steps,
+		       move.length,
+		       move.cruise_speed,
+		       move.acceleration,
+		       move.entry_speed);
+  }
+  return count;
+}
@@ -0,0 +1,33 @@
+#ifndef GANTRY_FEEDER_H
+#define GANTRY_FEEDER_H
+
+#include <vector>
+#include "gantry.h"
+
+class Planner;
+
+/// Transfers linear moves from a Gantry to a Planner in batches.
+/**
+   Moves are fetched with Gantry::get_moves() into a preallocated
+   batch, as many as the planner has free slots for, and then
+   planned one by one. No memory is allocated after construction.
+ */
+class GantryFeeder {
+ public:
+  /// Create feeder transferring at most batch_size moves per call.
+  GantryFeeder(Gantry *gantry, Planner *planner,
+	       unsigned batch_size, unsigned axes);
+
+  /// Transfer one batch of moves.
+  /** @returns number of moves added to planner. 0 if planner is full
+               or gantry has no more moves.
+  */
+  unsigned feed();
+
+ private:
+  Gantry *gantry;
+  Planner *planner;
+  std::vector<Gantry::LinearMove> batch;
+};
+
+#endif
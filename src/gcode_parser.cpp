@@ -0,0 +1,235 @@
+#include "gcode_parser.h"
+#include "gantry.h"
+
+namespace {
+  /// Fraction digits kept per number
+  const uint8_t max_decimals = 6;
+
+  /// Highest G or M code, larger numbers are errors
+  const int32_t max_code = 999;
+
+  const float inverse_pow10[max_decimals + 1] = {
+    1.0f, 1e-1f, 1e-2f, 1e-3f, 1e-4f, 1e-5f, 1e-6f
+  };
+
+  uint8_t to_upper(uint8_t byte) {
+    return (byte >= 'a' && byte <= 'z') ? byte - ('a' - 'A') : byte;
+  }
+
+  bool is_digit(uint8_t byte) {
+    return byte >= '0' && byte <= '9';
+  }
+}
+
+GcodeParser::GcodeParser(Gantry *gantry)
+  : gantry(gantry)
+  , state(State::IDLE)
+  , letter(0)
+  , negative(false)
+  , has_digits(false)
+  , mantissa(0)
+  , decimals(0)
+  , lines_(0)
+  , errors_(0)
+{
+  reset_line();
+}
+
+
+bool GcodeParser::consume(uint8_t byte)
+{
+  if (byte == '\n' || byte == '\r') {
+    return end_line();
+  }
+
+  switch (state) {
+  case State::COMMENT:
+    if (byte == ')') {
+      state = State::IDLE;
+    }
+    return false;
+
+  case State::SKIP_LINE:
+    return false;
+
+  case State::SIGN:
+    if (byte == '-' || byte == '+') {
+      if (has_digits || negative || letter == 'G' || letter == 'M') {
+	// Sign after digits, repeated or on a command
+	error = true;
+      }
+      negative = (byte == '-');
+      return false;
+    }
+    // Fall through to parse digits
+  case State::INTEGER:
+    if (is_digit(byte)) {
+      state = State::INTEGER;
+      has_digits = true;
+      if (mantissa < 100000000) {
+	mantissa = mantissa*10 + (byte - '0');
+      }
+      else {
+	// Integer part too large
+	error = true;
+      }
+      return false;
+    }
+    if (byte == '.') {
+      state = State::FRACTION;
+      return false;
+    }
+    end_word();
+    break;
+
+  case State::FRACTION:
+    if (is_digit(byte)) {
+      has_digits = true;
+      // Skip digits beyond precision
+      if (decimals < max_decimals && mantissa < 100000000) {
+	mantissa = mantissa*10 + (byte - '0');
+	decimals++;
+      }
+      return false;
+    }
+    end_word();
+    break;
+
+  case State::IDLE:
+    break;
+  }
+
+  // Start of new word, or separator
+  switch (byte) {
+  case ' ':
+  case '\t':
+    break;
+  case ';':
+  case '*':
+    state = State::SKIP_LINE;
+    break;
+  case '(':
+    state = State::COMMENT;
+    break;
+  default:
+    byte = to_upper(byte);
+    if (byte >= 'A' && byte <= 'Z') {
+      begin_word(byte);
+    }
+    else {
+      error = true;
+      state = State::SKIP_LINE;
+    }
+    break;
+  }
+  return false;
+}
+
+
+void GcodeParser::begin_word(uint8_t letter)
+{
+  this->letter = letter;
+  negative = false;
+  has_digits = false;
+  mantissa = 0;
+  decimals = 0;
+  state = State::SIGN;
+}
+
+
+void GcodeParser::end_word()
+{
+  state = State::IDLE;
+  if (!has_digits) {
+    error = true;
+    return;
+  }
+
+  if (letter == 'G' || letter == 'M') {
+    if (has_command || decimals != 0 || mantissa > max_code) {
+      // Only one command per line, no subcodes
+      error = true;
+      return;
+    }
+    has_command = true;
+    gcode = (letter == 'G') ? mantissa : -1;
+    return;
+  }
+
+  int axis;
+  switch (letter) {
+  case 'X': axis = X; break;
+  case 'Y': axis = Y; break;
+  case 'Z': axis = Z; break;
+  case 'E': axis = E; break;
+  case 'F': axis = F; break;
+  case 'N':
+    // Line number, ignored
+    return;
+  default:
+    error = true;
+    return;
+  }
+
+  // Integer values need no scaling
+  float value = mantissa;
+  if (decimals != 0) {
+    value *= inverse_pow10[decimals];
+  }
+  values[axis] = negative ? -value : value;
+  present |= 1 << axis;
+}
+
+
+bool GcodeParser::end_line()
+{
+  if (state == State::SIGN || state == State::INTEGER ||
+      state == State::FRACTION) {
+    end_word();
+  }
+
+  bool dispatched = false;
+  if (has_command || error) {
+    if (!error && (gcode == 0 || gcode == 1)) {
+      dispatch_move();
+      dispatched = true;
+    }
+    else {
+      errors_++;
+    }
+  }
+  else if (present) {
+    // Words without command
+    errors_++;
+  }
+
+  reset_line();
+  return dispatched;
+}
+
+
+void GcodeParser::dispatch_move()
+{
+  for (unsigned coord = X; coord <= Z; coord++) {
+    if (present & (1 << coord)) {
+      gantry->set_cartesian(coord, values[coord]);
+    }
+  }
+  if (present & (1 << E)) {
+    gantry->set_extruder(0, values[E]);
+  }
+  if (present & (1 << F)) {
+    gantry->set_speed(values[F]*(1.0f/60));
+  }
+  lines_++;
+}
+
+
+void GcodeParser::reset_line()
+{
+  state = State::IDLE;
+  gcode = -1;
+  has_command = false;
+  error = false;
+  present = 0;
+}
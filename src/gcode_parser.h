@@ -0,0 +1,103 @@
+#ifndef GCODE_PARSER_H
+#define GCODE_PARSER_H
+
+#include <stdint.h>
+
+class Gantry;
+
+/// Incremental G-code parser feeding a Gantry.
+/**
+   Bytes are consumed one at a time, straight from the receive buffer,
+   and words are decoded as they arrive. No line is ever copied and
+   nothing is allocated. Numbers are accumulated as integers and only
+   converted to float once per word, with a table lookup for the
+   decimal scaling.
+
+   Supported commands:
+   - G0/G1 with X, Y, Z, E (millimeters) and F (millimeters per minute)
+
+   Line numbers (N), checksums (*) and comments (; and parentheses)
+   are skipped. Other commands are counted as unsupported.
+ */
+class GcodeParser {
+ public:
+  explicit GcodeParser(Gantry *gantry);
+
+  /// Consume one byte.
+  /** @returns true when a line with a command has been completed and
+               dispatched to the gantry.
+  */
+  bool consume(uint8_t byte);
+
+  /// Consume bytes from buffer until one command has been dispatched.
+  /** Buffer must provide bool pop(uint8_t&), see RingBuffer.
+      As a command may give the gantry a new target, this should only
+      be called when the gantry has no more moves for its current
+      target.
+      @returns true if a command was dispatched, false if buffer ran
+               empty first.
+  */
+  template <class Buffer>
+  bool process(Buffer& rx) {
+    uint8_t byte;
+    while (rx.pop(byte)) {
+      if (consume(byte)) {
+	return true;
+      }
+    }
+    return false;
+  }
+
+  /// Number of command lines dispatched
+  uint32_t lines() const {
+    return lines_;
+  }
+
+  /// Number of lines with unsupported commands or malformed words
+  uint32_t errors() const {
+    return errors_;
+  }
+
+ private:
+  enum class State {
+    IDLE,      ///< Between words
+    SIGN,      ///< After letter, before any digit
+    INTEGER,   ///< Integer digits
+    FRACTION,  ///< Fraction digits
+    COMMENT,   ///< Inside parentheses
+    SKIP_LINE, ///< Ignore until end of line
+  };
+
+  /// Axis words stored per line
+  enum Axis {
+    X, Y, Z, E, F, AXES
+  };
+
+  void begin_word(uint8_t letter);
+  void end_word();
+  bool end_line();
+  void dispatch_move();
+  void reset_line();
+
+  Gantry *gantry;
+  State state;
+
+  // Current word
+  uint8_t letter;
+  bool negative;
+  bool has_digits;
+  int32_t mantissa;
+  uint8_t decimals;
+
+  // Current line
+  int16_t gcode;
+  bool has_command;
+  bool error;
+  uint8_t present;
+  float values[AXES];
+
+  uint32_t lines_;
+  uint32_t errors_;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "homing.h"
+#include "planner.h"
+#include "trapezoid_ticker.h"
+#include <cmath>
+
+Homing::Homing(StepperGroup *steppers,
+	       const std::vector<DeltaGantry::Axis>& axes,
+	       const std::vector<int>& home_steps,
+	       DeltaGantry *gantry,
+	       Planner *planner,
+	       TrapezoidTicker *ticker,
+	       const Config& config)
+  : steppers(steppers)
+  , axes(axes)
+  , home_steps(home_steps)
+  , towers((1u << home_steps.size()) - 1)
+  , gantry(gantry)
+  , planner(planner)
+  , ticker(ticker)
+  , config(config)
+  , state_(State::IDLE)
+  , steps(steppers->size())
+{
+}
+
+
+void Homing::start()
+{
+  steppers->enable();
+  arm_endstops(true);
+  move_towers(config.travel, config.fast_speed);
+  state_ = State::FAST_APPROACH;
+}
+
+
+Homing::State Homing::poll()
+{
+  switch (state_) {
+  case State::FAST_APPROACH:
+    if (settle(true)) {
+      if (!all_triggered()) {
+	arm_endstops(true);
+	state_ = State::FAILED;
+	break;
+      }
+      // Stopped towers are made active again to move away
+      steppers->enable();
+      arm_endstops(false);
+      move_towers(-config.backoff, config.fast_speed);
+      state_ = State::BACKOFF;
+    }
+    break;
+
+  case State::BACKOFF:
+    if (settle(false)) {
+      arm_endstops(true);
+      move_towers(2*config.backoff, config.slow_speed);
+      state_ = State::SLOW_APPROACH;
+    }
+    break;
+
+  case State::SLOW_APPROACH:
+    if (settle(true)) {
+      if (all_triggered() && set_home_positions()) {
+	state_ = State::DONE;
+      }
+      else {
+	state_ = State::FAILED;
+      }
+      // Endstops stay armed, they only stop towers moving towards
+      // them. Enabled last, as arming may stop a tower on its switch.
+      arm_endstops(true);
+      steppers->enable();
+    }
+    break;
+
+  default:
+    break;
+  }
+  return state_;
+}
+
+
+void Homing::move_towers(float distance, float speed)
+{
+  for (unsigned axis = 0; axis < steps.size(); ++axis) {
+    steps[axis] = axis < home_steps.size() ?
+      std::lround(distance*axes[axis].steps_per_mm) : 0;
+  }
+  planner->plan_move(steps, std::fabs(distance), speed,
+		     config.acceleration, 0);
+  ticker->start(planner);
+}
+
+
+void Homing::arm_endstops(bool arm)
+{
+  // Disarmed first, a tower resting on its switch may trigger again
+  steppers->stop_on_endstop(arm ? towers : 0);
+  steppers->clear_endstop_triggers(towers);
+}
+
+
+bool Homing::all_triggered() const
+{
+  return (steppers->endstop_triggers() & towers) == towers;
+}
+
+
+bool Homing::settle(bool abort)
+{
+  if (ticker->is_running()) {
+    if (abort && all_triggered()) {
+      ticker->stop();
+    }
+    return false;
+  }
+  planner->clear();
+  return true;
+}
+
+
+bool Homing::set_home_positions()
+{
+  for (unsigned axis = 0; axis < steppers->size(); ++axis) {
+    steps[axis] = steppers->position(axis);
+    if (axis < home_steps.size()) {
+      // Steps taken after the trigger, if any, are kept
+      steps[axis] += home_steps[axis] - steppers->trigger_position(axis);
+    }
+  }
+  if (!gantry->set_position_from_steps(steps)) {
+    return false;
+  }
+  for (unsigned axis = 0; axis < steppers->size(); ++axis) {
+    steppers->set_position(axis, steps[axis]);
+  }
+  return true;
+}
@@ -0,0 +1,106 @@
+#ifndef HOMING_H
+#define HOMING_H
+
+#include <vector>
+#include "delta_gantry.h"
+#include "stepper_group.h"
+
+class Planner;
+class TrapezoidTicker;
+
+/// Homes the delta towers against their endstops.
+/**
+   All towers move together towards their endstops, which are at the
+   positive end of the towers. Each tower stops on its own endstop,
+   and the move is aborted when all have triggered, so the fast
+   approach takes only as long as the farthest tower needs. The towers
+   then back off and approach again at low speed, where the trigger
+   positions are precise. Finally the tower positions are set so that
+   the trigger position is the home position, and the gantry is
+   resynchronized with the steppers. The endstops are left armed; as
+   the StepperGroup only stops axes moving towards their endstops, the
+   towers can leave the switches and are stopped when they return.
+
+   Moves go through the planner and ticker like any other move. Like
+   MotionPipeline, poll() is called from the main loop, and nothing
+   else may use the planner or ticker while homing.
+ */
+class Homing {
+ public:
+  /// Homing moves, distances in mm of carriage travel
+  struct Config {
+    /// Speed towards endstops in mm/s
+    float fast_speed;
+    /// Speed of the precise approach in mm/s
+    float slow_speed;
+    /// Acceleration in mm/s^2
+    float acceleration;
+    /// Longest distance to search for the endstops
+    float travel;
+    /// Distance to move back before the precise approach
+    float backoff;
+  };
+
+  enum class State {
+    IDLE,          ///< Not started
+    FAST_APPROACH, ///< Moving towards endstops at fast_speed
+    BACKOFF,       ///< Moving away from endstops
+    SLOW_APPROACH, ///< Moving towards endstops at slow_speed
+    DONE,          ///< Positions are set
+    FAILED,        ///< An endstop was not found or home is unreachable,
+                   ///< positions are unchanged
+  };
+
+  /** @param steppers all axes, towers first as for the gantry
+      @param axes configuration of all axes
+      @param home_steps tower positions in steps at the endstops
+   */
+  Homing(StepperGroup *steppers,
+	 const std::vector<DeltaGantry::Axis>& axes,
+	 const std::vector<int>& home_steps,
+	 DeltaGantry *gantry,
+	 Planner *planner,
+	 TrapezoidTicker *ticker,
+	 const Config& config);
+
+  /// Start homing, the ticker must be idle.
+  void start();
+
+  /// Advance homing, returns current state.
+  State poll();
+
+  State state() const {
+    return state_;
+  }
+
+ private:
+  /// Move all towers distance at speed, positive towards endstops
+  void move_towers(float distance, float speed);
+
+  /// Arm or disarm endstops of towers
+  void arm_endstops(bool arm);
+
+  bool all_triggered() const;
+
+  /// Returns true when the ticker has stopped and the planner is empty.
+  /** Aborts the current move if all towers have triggered.
+   */
+  bool settle(bool abort);
+
+  /// Set tower and gantry positions, false if gantry rejects them
+  bool set_home_positions();
+
+  StepperGroup *steppers;
+  std::vector<DeltaGantry::Axis> axes;
+  std::vector<int> home_steps;
+  /// Axes of the towers
+  StepperGroup::Mask towers;
+  DeltaGantry *gantry;
+  Planner *planner;
+  TrapezoidTicker *ticker;
+  Config config;
+  State state_;
+  std::vector<int> steps;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "motion_pipeline.h"
+#include "planner.h"
+#include "trapezoid_ticker.h"
+
+MotionPipeline::MotionPipeline(Gantry *gantry,
+			       Planner *planner,
+			       TrapezoidTicker *ticker,
+			       unsigned batch_size,
+			       unsigned axes)
+  : planner(planner)
+  , ticker(ticker)
+  , feeder(gantry, planner, batch_size, axes)
+  , gantry_drained(false)
+  , stats_()
+{
+}
+
+
+unsigned MotionPipeline::poll()
+{
+  stats_.polls++;
+
+  unsigned count = 0;
+  if (planner->is_buffer_full()) {
+    stats_.stalls++;
+  }
+  else {
+    count = feeder.feed();
+    gantry_drained = (count == 0);
+    stats_.moves += count;
+  }
+
+  if (!ticker->is_running() && planner->get_current_move()) {
+    stats_.restarts++;
+    ticker->start(planner);
+  }
+
+  return count;
+}
+
+
+bool MotionPipeline::is_idle() const
+{
+  return gantry_drained && !ticker->is_running() &&
+    !planner->get_current_move();
+}
@@ -0,0 +1,62 @@
+#ifndef MOTION_PIPELINE_H
+#define MOTION_PIPELINE_H
+
+#include <cstdint>
+#include "gantry_feeder.h"
+
+class Gantry;
+class Planner;
+class TrapezoidTicker;
+
+/// Drives moves from a Gantry through a Planner to a TrapezoidTicker.
+/**
+   Intended to be polled from a non-blocking main loop. Each call to
+   poll() does a bounded amount of work: at most one batch of segments
+   is pulled from the gantry, and only while the planner has room.
+   The ticker is (re)started whenever there are planned moves and it
+   has gone idle.
+ */
+class MotionPipeline {
+ public:
+  /// Counters for monitoring throughput
+  struct Stats {
+    std::uint32_t polls;    ///< Calls to poll()
+    std::uint32_t moves;    ///< Segments added to planner
+    std::uint32_t stalls;   ///< Polls finding planner full
+    std::uint32_t restarts; ///< Times ticker was started
+  };
+
+  /// Create pipeline transferring at most batch_size segments per poll.
+  MotionPipeline(Gantry *gantry, Planner *planner, TrapezoidTicker *ticker,
+		 unsigned batch_size, unsigned axes);
+
+  /// Do one time slice of work.
+  /** @returns number of segments added to planner
+   */
+  unsigned poll();
+
+  /// Returns true when gantry has no more segments for current target.
+  /** Set by poll(). New targets should only be given to the gantry
+      when drained.
+   */
+  bool is_gantry_drained() const {
+    return gantry_drained;
+  }
+
+  /// Returns true when all moves have been executed
+  bool is_idle() const;
+
+  /// Get throughput counters
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  Planner *planner;
+  TrapezoidTicker *ticker;
+  GantryFeeder feeder;
+  bool gantry_drained;
+  Stats stats_;
+};
+
+#endif
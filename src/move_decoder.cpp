@@ -0,0 +1,221 @@
+#include "move_decoder.h"
+#include "planner.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace move_protocol;
+
+MoveDecoder::MoveDecoder(Planner *planner, unsigned axes)
+  : planner(planner)
+  , axes(axes)
+  , state(State::SYNC)
+  , has_header(false)
+  , lost(false)
+  , sequence(0)
+  , type(0)
+  , size(0)
+  , expected_size(0)
+  , sum1(0)
+  , steps(axes)
+  , resync_steps(axes)
+  , position(axes)
+  , moves_(0)
+  , errors_(0)
+  , gaps_(0)
+{
+  // Key move positions are decoded into a max_axes array
+  assert(axes <= max_axes);
+  for (uint8_t field = 0; field < fields; field++) {
+    values[field] = 0;
+  }
+}
+
+
+bool MoveDecoder::consume(uint8_t byte)
+{
+  switch (state) {
+  case State::SYNC:
+    if (byte == sync) {
+      state = State::TYPE;
+      checksum = Checksum();
+    }
+    return false;
+
+  case State::TYPE:
+    type = byte;
+    checksum.add(byte);
+    size = 0;
+    if (type == header_type) {
+      expected_size = 2;
+    }
+    else if (type == move_type || type == key_move_type) {
+      // Size known after flags
+      expected_size = 1;
+    }
+    else {
+      errors_++;
+      state = State::SYNC;
+      return false;
+    }
+    state = State::PAYLOAD;
+    return false;
+
+  case State::PAYLOAD:
+    if (size == max_payload) {
+      // Too many axes for this stream format
+      errors_++;
+      state = State::SYNC;
+      return false;
+    }
+    payload[size++] = byte;
+    checksum.add(byte);
+    if (type != header_type && size == 1) {
+      expected_size = move_payload_size(type, byte, axes);
+    }
+    if (size == expected_size) {
+      state = State::SUM1;
+    }
+    return false;
+
+  case State::SUM1:
+    sum1 = byte;
+    state = State::SUM2;
+    return false;
+
+  case State::SUM2:
+    state = State::SYNC;
+    if (sum1 != checksum.first() || byte != checksum.second()) {
+      errors_++;
+      return false;
+    }
+    return end_record();
+  }
+  return false;
+}
+
+
+bool MoveDecoder::end_record()
+{
+  if (type == header_type) {
+    has_header = (payload[0] == version && payload[1] == axes);
+    if (!has_header) {
+      errors_++;
+    }
+    lost = false;
+    sequence = 0;
+    for (auto& pos : position) {
+      pos = 0;
+    }
+    return false;
+  }
+
+  if (!has_header) {
+    errors_++;
+    return false;
+  }
+  return decode_move();
+}
+
+
+bool MoveDecoder::decode_move()
+{
+  uint8_t flags = payload[0];
+  if (payload[1] != sequence && !lost) {
+    lost = true;
+    gaps_++;
+  }
+  sequence = payload[1] + 1;
+  bool key = (type == key_move_type);
+  if (lost && !key) {
+    // Position and repeated fields are unknown until a key move
+    errors_++;
+    return false;
+  }
+
+  uint8_t pos = 2;
+  for (unsigned axis = 0; axis < axes; axis++) {
+    if (flags & wide_steps) {
+      steps[axis] = static_cast<int16_t>(payload[pos] | (payload[pos + 1] << 8));
+      pos += 2;
+    }
+    else {
+      steps[axis] = static_cast<int8_t>(payload[pos]);
+      pos += 1;
+    }
+  }
+
+  int32_t start[max_axes];
+  if (key) {
+    for (unsigned axis = 0; axis < axes; axis++) {
+      uint32_t bits = 0;
+      for (uint8_t byte = 0; byte < 4; byte++) {
+	bits |= static_cast<uint32_t>(payload[pos++]) << (8*byte);
+      }
+      start[axis] = bits;
+    }
+  }
+
+  for (uint8_t field = 0; field < fields; field++) {
+    if (flags & (1 << field)) {
+      uint32_t bits = 0;
+      for (uint8_t byte = 0; byte < 4; byte++) {
+	bits |= static_cast<uint32_t>(payload[pos++]) << (8*byte);
+      }
+      memcpy(&values[field], &bits, sizeof(bits));
+    }
+  }
+
+  if (key && !lost) {
+    for (unsigned axis = 0; axis < axes; axis++) {
+      if (start[axis] != position[axis]) {
+	lost = true;
+	gaps_++;
+	break;
+      }
+    }
+  }
+  float entry_speed = values[3];
+  if (lost) {
+    // The resync move ends at rest, so the key move starts from rest
+    if (plan_resync(start)) {
+      entry_speed = 0;
+    }
+    lost = false;
+  }
+  planner->plan_move(steps, values[0], values[1], values[2], entry_speed);
+  for (unsigned axis = 0; axis < axes; axis++) {
+    position[axis] += steps[axis];
+  }
+  moves_++;
+  return true;
+}
+
+
+bool MoveDecoder::plan_resync(const int32_t *start)
+{
+  int most = 0;
+  int most_key = 0;
+  for (unsigned axis = 0; axis < axes; axis++) {
+    resync_steps[axis] = start[axis] - position[axis];
+    position[axis] = start[axis];
+    most = std::max(most, std::abs(resync_steps[axis]));
+    most_key = std::max(most_key, std::abs(steps[axis]));
+  }
+  if (most == 0) {
+    return false;
+  }
+  float length = values[0];
+  if (most_key > 0) {
+    length = length*most/most_key;
+  }
+  planner->plan_move(resync_steps, length, values[1], values[2], 0);
+  return true;
+}
+
+
+bool MoveDecoder::is_planner_full() const
+{
+  return planner->free_slots() < 2;
+}
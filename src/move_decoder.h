@@ -0,0 +1,113 @@
+#ifndef MOVE_DECODER_H
+#define MOVE_DECODER_H
+
+#include <vector>
+#include <stdint.h>
+#include "move_protocol.h"
+
+class Planner;
+
+/// Decodes a binary move stream straight into a Planner.
+/**
+   Bytes are consumed one at a time, see move_protocol.h for the
+   format. Records with bad checksum are dropped and the decoder
+   searches for the next sync byte. Moves are rejected until a header
+   with matching version and number of axes has been received.
+
+   A gap in the move sequence numbers means moves were lost. Moves are
+   then dropped until a key move, which restores the position with an
+   extra move at the speed of the key move, starting and ending at
+   rest: the key move is then planned with entry speed 0.
+ */
+class MoveDecoder {
+ public:
+  /// axes must be at most move_protocol::max_axes
+  MoveDecoder(Planner *planner, unsigned axes);
+
+  /// Consume one byte.
+  /** The planner must have room for two moves when called, as a
+      completed move record is planned immediately, and a key move
+      after a gap is planned as two moves.
+      @returns true when a move has been planned.
+  */
+  bool consume(uint8_t byte);
+
+  /// Consume bytes from buffer while the planner has room.
+  /** Buffer must provide bool pop(uint8_t&), see RingBuffer.
+      @returns number of moves planned
+  */
+  template <class Buffer>
+  unsigned process(Buffer& rx);
+
+  /// Number of moves planned
+  uint32_t moves() const {
+    return moves_;
+  }
+
+  /// Number of dropped records
+  uint32_t errors() const {
+    return errors_;
+  }
+
+  /// Number of gaps detected in the move sequence
+  uint32_t gaps() const {
+    return gaps_;
+  }
+
+ private:
+  enum class State {
+    SYNC,
+    TYPE,
+    PAYLOAD,
+    SUM1,
+    SUM2,
+  };
+
+  bool end_record();
+  bool decode_move();
+  /// Plan move from position to start of key move, length scaled
+  /// from the key move by the steps of the axis with most steps
+  /// @returns false if already at the start, and nothing was planned
+  bool plan_resync(const int32_t *start);
+  bool is_planner_full() const;
+
+  Planner *planner;
+  unsigned axes;
+  State state;
+  bool has_header;
+  /// Moves were lost, waiting for key move
+  bool lost;
+  uint8_t sequence;
+
+  uint8_t type;
+  uint8_t size;
+  uint8_t expected_size;
+  uint8_t sum1;
+  move_protocol::Checksum checksum;
+  uint8_t payload[move_protocol::max_payload];
+
+  std::vector<int> steps;
+  std::vector<int> resync_steps;
+  std::vector<int32_t> position;
+  float values[move_protocol::fields];
+
+  uint32_t moves_;
+  uint32_t errors_;
+  uint32_t gaps_;
+};
+
+
+template <class Buffer>
+unsigned MoveDecoder::process(Buffer& rx)
+{
+  unsigned count = 0;
+  uint8_t byte;
+  while (!is_planner_full() && rx.pop(byte)) {
+    if (consume(byte)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include "move_encoder.h"
+#include "move_protocol.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace move_protocol;
+
+const int MoveEncoder::max_steps;
+
+MoveEncoder::MoveEncoder(unsigned axes)
+  : axes(axes)
+  , first_move(true)
+  , sequence(0)
+  , since_key(0)
+  , position(axes)
+  , part(axes)
+{
+}
+
+
+void MoveEncoder::header(std::vector<uint8_t>& out)
+{
+  payload.clear();
+  payload.push_back(version);
+  payload.push_back(axes);
+  record(header_type, payload, out);
+  first_move = true;
+  sequence = 0;
+  for (auto& pos : position) {
+    pos = 0;
+  }
+}
+
+
+void MoveEncoder::encode(const Gantry::LinearMove& move,
+			 std::vector<uint8_t>& out)
+{
+  int most = 0;
+  for (unsigned axis = 0; axis < axes; axis++) {
+    most = std::max(most, std::abs(move.steps[axis]));
+  }
+  int parts = (most + max_steps - 1)/max_steps;
+  if (parts <= 1) {
+    const float values[fields] = {
+      move.length, move.cruise_speed, move.acceleration, move.entry_speed
+    };
+    encode_part(move.steps, values, out);
+    return;
+  }
+
+  // Parts are collinear, later parts can be entered at full speed
+  const float values[fields] = {
+    move.length/parts, move.cruise_speed, move.acceleration, move.entry_speed
+  };
+  const float next_values[fields] = {
+    move.length/parts, move.cruise_speed, move.acceleration,
+    move.cruise_speed
+  };
+  for (int ind = 0; ind < parts; ind++) {
+    for (unsigned axis = 0; axis < axes; axis++) {
+      int64_t steps = move.steps[axis];
+      part[axis] = steps*(ind + 1)/parts - steps*ind/parts;
+    }
+    encode_part(part, ind == 0 ? values : next_values, out);
+  }
+}
+
+
+void MoveEncoder::encode_part(const std::vector<int>& steps,
+			      const float *values,
+			      std::vector<uint8_t>& out)
+{
+  bool key = first_move || since_key + 1 >= key_interval;
+  since_key = key ? 0 : since_key + 1;
+
+  uint8_t flags = 0;
+  for (unsigned field = 0; field < fields; field++) {
+    if (key || values[field] != previous[field]) {
+      flags |= 1 << field;
+    }
+    previous[field] = values[field];
+  }
+  first_move = false;
+
+  for (unsigned axis = 0; axis < axes; axis++) {
+    if (steps[axis] < -128 || steps[axis] > 127) {
+      flags |= wide_steps;
+    }
+  }
+
+  payload.clear();
+  payload.push_back(flags);
+  payload.push_back(sequence++);
+  for (unsigned axis = 0; axis < axes; axis++) {
+    int16_t axis_steps = steps[axis];
+    payload.push_back(axis_steps & 0xff);
+    if (flags & wide_steps) {
+      payload.push_back((axis_steps >> 8) & 0xff);
+    }
+  }
+
+  if (key) {
+    for (unsigned axis = 0; axis < axes; axis++) {
+      uint32_t bits = position[axis];
+      for (unsigned byte = 0; byte < 4; byte++) {
+	payload.push_back((bits >> (8*byte)) & 0xff);
+      }
+    }
+  }
+  for (unsigned axis = 0; axis < axes; axis++) {
+    position[axis] += steps[axis];
+  }
+
+  for (unsigned field = 0; field < fields; field++) {
+    if (flags & (1 << field)) {
+      uint32_t bits;
+      std::memcpy(&bits, &values[field], sizeof(bits));
+      for (unsigned byte = 0; byte < 4; byte++) {
+	payload.push_back((bits >> (8*byte)) & 0xff);
+      }
+    }
+  }
+
+  record(key ? key_move_type : move_type, payload, out);
+}
+
+
+void MoveEncoder::record(uint8_t type, const std::vector<uint8_t>& payload,
+			 std::vector<uint8_t>& out)
+{
+  Checksum checksum;
+  out.push_back(sync);
+  out.push_back(type);
+  checksum.add(type);
+  for (uint8_t byte : payload) {
+    out.push_back(byte);
+    checksum.add(byte);
+  }
+  out.push_back(checksum.first());
+  out.push_back(checksum.second());
+}
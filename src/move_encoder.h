@@ -0,0 +1,48 @@
+#ifndef MOVE_ENCODER_H
+#define MOVE_ENCODER_H
+
+#include <vector>
+#include <stdint.h>
+#include "gantry.h"
+
+/// Encodes linear moves into a binary move stream.
+/**
+   Host side counterpart of MoveDecoder, see move_protocol.h for
+   the format.
+ */
+class MoveEncoder {
+ public:
+  explicit MoveEncoder(unsigned axes);
+
+  /// Append stream header to out. Must be written first.
+  void header(std::vector<uint8_t>& out);
+
+  /// Append move records to out.
+  /** Moves with more than max_steps on an axis are split into equal
+      parts, each one record.
+  */
+  void encode(const Gantry::LinearMove& move, std::vector<uint8_t>& out);
+
+  /// Most steps per axis in one record
+  static const int max_steps = 32767;
+
+ private:
+  /// Append one move record, steps within max_steps
+  void encode_part(const std::vector<int>& steps, const float *values,
+		   std::vector<uint8_t>& out);
+
+  void record(uint8_t type, const std::vector<uint8_t>& payload,
+	      std::vector<uint8_t>& out);
+
+  unsigned axes;
+  bool first_move;
+  float previous[4];
+  uint8_t sequence;
+  /// Moves since last key move
+  uint8_t since_key;
+  std::vector<int32_t> position;
+  std::vector<int> part;
+  std::vector<uint8_t> payload;
+};
+
+#endif
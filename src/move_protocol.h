@@ -0,0 +1,108 @@
+#ifndef MOVE_PROTOCOL_H
+#define MOVE_PROTOCOL_H
+
+#include <stdint.h>
+
+/// Binary move stream format, shared by MoveEncoder and MoveDecoder.
+/**
+   The stream is a sequence of records:
+
+   \code
+   sync | type | payload | sum1 | sum2
+   \endcode
+
+   where sync is always 0xa5 and sum1, sum2 is a Fletcher-16 checksum
+   over type and payload. All multi-byte values are little endian,
+   floats are IEEE 754 single precision.
+
+   Record types:
+   - 'H' header, payload: version, axes. Must precede any move, and
+     decoders reject streams with another version or number of axes.
+     Positions and sequence numbers start from 0 after a header.
+   - 'M' move, payload: flags, sequence, steps per axis, followed by
+     the float fields flagged as present, in order length, speed,
+     acceleration, entry speed. Fields not present repeat the value
+     from the previous move. Steps are int8 unless flag wide_steps is
+     set, then int16. Longer moves are split by the encoder.
+   - 'K' key move, payload as 'M' but with the int32 position of each
+     axis at the start of the move inserted after the steps, and all
+     fields present. Sent as the first move and then every
+     key_interval moves.
+
+   The sequence number increments by one per move record. Moves are
+   relative, so a lost record shifts all later positions. A decoder
+   that sees a gap in the sequence drops moves until the next key
+   move, then plans a move from its position to the start position of
+   the key move before the key move itself.
+ */
+namespace move_protocol {
+  const uint8_t version = 2;
+  const uint8_t sync = 0xa5;
+
+  const uint8_t header_type = 'H';
+  const uint8_t move_type = 'M';
+  const uint8_t key_move_type = 'K';
+
+  /// Moves between key moves
+  const uint8_t key_interval = 16;
+
+  /// Number of float fields in move record
+  const uint8_t fields = 4;
+
+  /// Move flags
+  enum Flags {
+    has_length = 1 << 0,
+    has_speed = 1 << 1,
+    has_acceleration = 1 << 2,
+    has_entry_speed = 1 << 3,
+    wide_steps = 1 << 7,
+  };
+
+  /// Max number of axes in a stream
+  const uint8_t max_axes = 8;
+
+  /// Max payload size of any record
+  const uint8_t max_payload = 2 + 2*max_axes + 4*max_axes + 4*fields;
+
+  /// Running Fletcher-16 checksum
+  class Checksum {
+  public:
+    Checksum()
+      : sum1(0)
+      , sum2(0)
+    {
+    }
+
+    void add(uint8_t byte) {
+      sum1 = (sum1 + byte) % 255;
+      sum2 = (sum2 + sum1) % 255;
+    }
+
+    uint8_t first() const {
+      return sum1;
+    }
+
+    uint8_t second() const {
+      return sum2;
+    }
+  private:
+    uint8_t sum1, sum2;
+  };
+
+  /// Payload size of move record of type given its flags
+  inline uint8_t move_payload_size(uint8_t type, uint8_t flags,
+				   uint8_t axes) {
+    uint8_t size = 2 + axes*((flags & wide_steps) ? 2 : 1);
+    if (type == key_move_type) {
+      size += 4*axes;
+    }
+    for (uint8_t field = 0; field < fields; field++) {
+      if (flags & (1 << field)) {
+	size += 4;
+      }
+    }
+    return size;
+  }
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef MULTI_BRESENHAM_H
+#define MULTI_BRESENHAM_H
+
+#include <cstdint>
+
+/// Bresenham's algorithm for N axes stepped by the same events.
+/**
+   Same stepping as N Bresenham objects, but the error terms of all
+   axes are stored together and one tick() returns a bitmask with a
+   bit set for each axis to step. The loops have no branches, so the
+   cost of an event barely depends on how many axes step, and on the
+   host the compiler can vectorize them.
+
+   With step = error < 0, the update error += step ? dxy : -dy of
+   Bresenham is written as error += (-step & 2dx) - 2dy.
+ */
+template <unsigned N>
+class MultiBresenham {
+  static_assert(N >= 1 && N <= 32, "MultiBresenham supports 1 to 32 axes");
+ public:
+  /// Bit i set means step axis i
+  typedef std::uint32_t Mask;
+
+  static const unsigned axes = N;
+
+  /// All axes with zero slope
+  MultiBresenham()
+    : error()
+    , dx()
+    , dy()
+  {
+  }
+
+  /// Make dy steps on axis per dx ticks, see Bresenham.
+  void set(unsigned axis, int dy, int dx, int offset = 0) {
+    error[axis] = dx*offset - dy*2;
+    this->dx[axis] = dx*2;
+    this->dy[axis] = dy*2;
+  }
+
+  /// Move one step in x direction.
+  /** Returns mask of axes that should take a step.
+   */
+  inline Mask tick() {
+    Mask mask = 0;
+    for (unsigned axis = 0; axis < N; ++axis) {
+      mask |= static_cast<Mask>(error[axis] < 0) << axis;
+    }
+    for (unsigned axis = 0; axis < N; ++axis) {
+      int step = error[axis] < 0;
+      error[axis] += (-step & dx[axis]) - dy[axis];
+    }
+    return mask;
+  }
+
+ private:
+  int error[N];
+  int dx[N];
+  int dy[N];
+};
+
+template <unsigned N>
+const unsigned MultiBresenham<N>::axes;
+
+#endif
@@ -1,21 +1,156 @@
 #ifndef PIN_IO
 #define PIN_IO
 
-#include <cstdint>
+#include <stdint.h>
 
 /** Interface for modifying single io pins.
+
+    Pins are grouped in 8-bit ports, pin_no/8 is the port and pin_no%8
+    the bit within the port. Several pins of a port can be changed at
+    once with the mask operations, which an implementation can map to
+    a single register write. The default mask operations call set()
+    and clear() for each pin.
  */
 class PinIo {
  public:
   /** Pin points out a specific io pin
    */
   struct Pin {
-    std::uint8_t pin_no;
+    uint8_t pin_no;
   };
 
+  static uint8_t port(Pin pin) {
+    return pin.pin_no >> 3;
+  }
+
+  static uint8_t bit(Pin pin) {
+    return 1 << (pin.pin_no & 7);
+  }
+
   virtual void set(Pin) = 0;
   virtual void clear(Pin) = 0;
   virtual bool get(Pin) = 0;
+
+  /// Set pins of port with bit set in mask
+  virtual void set_mask(uint8_t port, uint8_t mask) {
+    for_each_pin(port, mask, &PinIo::set);
+  }
+
+  /// Clear pins of port with bit set in mask
+  virtual void clear_mask(uint8_t port, uint8_t mask) {
+    for_each_pin(port, mask, &PinIo::clear);
+  }
+
+  /// Set pins of port in mask to the corresponding bit of value
+  virtual void write_mask(uint8_t port, uint8_t mask,
+			  uint8_t value) {
+    set_mask(port, mask & value);
+    clear_mask(port, mask & ~value);
+  }
+
+ private:
+  void for_each_pin(uint8_t port, uint8_t mask,
+		    void (PinIo::*operation)(Pin)) {
+    for (uint8_t bit = 0; bit < 8; ++bit) {
+      if (mask & (1 << bit)) {
+	(this->*operation)(Pin{static_cast<uint8_t>(port*8 + bit)});
+      }
+    }
+  }
+};
+
+/** Set of pins, precomputed as one mask per port.
+
+    Pins are selected by their index in the set, bit i of a selection
+    is the i:th added pin. Each operation makes one mask call per port
+    with a selected pin, so pins sharing a port change together.
+ */
+class PinSet {
+ public:
+  static const unsigned max_pins = 8;
+
+  PinSet()
+    : pins(0)
+    , ports(0)
+  {
+  }
+
+  /// Add pin, returns its index or max_pins if full
+  unsigned add(PinIo::Pin pin) {
+    if (pins == max_pins) {
+      return max_pins;
+    }
+    uint8_t port = PinIo::port(pin);
+    unsigned group = 0;
+    while (group < ports && groups[group].port != port) {
+      ++group;
+    }
+    if (group == ports) {
+      groups[group].port = port;
+      groups[group].selection = 0;
+      ++ports;
+    }
+    groups[group].selection |= 1 << pins;
+    pin_bit[pins] = PinIo::bit(pin);
+    return pins++;
+  }
+
+  unsigned size() const {
+    return pins;
+  }
+
+  /// Set selected pins
+  void set(PinIo *io, uint8_t selection) const {
+    for (unsigned group = 0; group < ports; ++group) {
+      if (uint8_t mask = port_mask(group, selection)) {
+	io->set_mask(groups[group].port, mask);
+      }
+    }
+  }
+
+  /// Clear selected pins
+  void clear(PinIo *io, uint8_t selection) const {
+    for (unsigned group = 0; group < ports; ++group) {
+      if (uint8_t mask = port_mask(group, selection)) {
+	io->clear_mask(groups[group].port, mask);
+      }
+    }
+  }
+
+  /// Write selected pins to corresponding bit of values
+  void write(PinIo *io, uint8_t selection, uint8_t values) const {
+    for (unsigned group = 0; group < ports; ++group) {
+      if (uint8_t mask = port_mask(group, selection)) {
+	io->write_mask(groups[group].port, mask,
+		       port_mask(group, values));
+      }
+    }
+  }
+
+ private:
+  /// Port bits of selected pins in group
+  uint8_t port_mask(unsigned group, uint8_t selection) const {
+    uint8_t mask = 0;
+    // Shifted selection, a bit scan is a library call on AVR
+    uint8_t in_group = selection & groups[group].selection;
+    for (unsigned pin = 0; in_group; ++pin, in_group >>= 1) {
+      if (in_group & 1) {
+	mask |= pin_bit[pin];
+      }
+    }
+    return mask;
+  }
+
+  struct Group {
+    uint8_t port;
+    /// Pins of set on this port
+    uint8_t selection;
+  };
+
+  unsigned pins;
+  unsigned ports;
+  Group groups[max_pins];
+  uint8_t pin_bit[max_pins];
 };
 
 #endif
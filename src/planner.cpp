@@ -20,6 +20,17 @@ bool Planner::is_buffer_full() const
 }
 
 
+unsigned Planner::free_slots() const
+{
+  std::size_t used = block_buffer_head + block_buffer.size() -
+    block_buffer_tail;
+  if (used >= block_buffer.size()) {
+    used -= block_buffer.size();
+  }
+  return block_buffer.size() - 1 - used;
+}
+
+
 const Move* Planner::get_current_move() const
 {
   if (block_buffer_head == block_buffer_tail) {
@@ -66,6 +77,13 @@ void Planner::next_move()
 }
 
 
+void Planner::clear()
+{
+  block_buffer_tail = block_buffer_head;
+  block_buffer_planned = block_buffer_head;
+}
+
+
 void Planner::plan_move(const std::vector<int>& steps,
 			float length,
 			float speed,
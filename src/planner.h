@@ -31,6 +31,9 @@ class Planner {
   /// Check if no moves can be added
   bool is_buffer_full() const;
 
+  /// Return number of moves that can be added
+  unsigned free_slots() const;
+
   /// Returns current steps or nullptr if empty
   const Move* get_current_move() const;
 
@@ -45,6 +48,11 @@ class Planner {
 
   /// Discard current move
   void next_move();
+
+  /// Discard all moves.
+  /** Must not be called while a ticker is executing moves.
+   */
+  void clear();
  private:
   void recalculate();
   std::size_t next_block_index(std::size_t block_index) const;
@@ -0,0 +1,149 @@
+#include "profile_analysis.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  /// Entry and exit rates that can be reached within the profile
+  void reachable_rates(const ProfileSpec& spec, double& entry, double& exit) {
+    double ramp = 2.0*spec.acc*spec.steps;
+    entry = std::min<double>(spec.entry_rate, spec.nominal_rate);
+    exit = std::min<double>(spec.exit_rate, spec.nominal_rate);
+    exit = std::min(exit, std::sqrt(entry*entry + ramp));
+    entry = std::min(entry, std::sqrt(exit*exit + ramp));
+  }
+
+  /// Squared analytic velocity after s steps, from reachable rates
+  double ideal_velocity_sqr(const ProfileSpec& spec, double entry,
+			    double exit, double s) {
+    double accelerating = entry*entry + 2.0*spec.acc*s;
+    double decelerating = exit*exit + 2.0*spec.acc*(spec.steps - s);
+    double nominal = spec.nominal_rate;
+    return std::min(std::min(accelerating, decelerating), nominal*nominal);
+  }
+}
+
+ProfileAnalyzer::ProfileAnalyzer(float timer_frequency)
+  : timer_frequency(timer_frequency)
+  , record_curves(false)
+  , report()
+{
+}
+
+
+double ProfileAnalyzer::ideal_velocity(const ProfileSpec& spec, double s)
+{
+  double entry, exit;
+  reachable_rates(spec, entry, exit);
+  return std::sqrt(ideal_velocity_sqr(spec, entry, exit, s));
+}
+
+
+bool ProfileAnalyzer::is_feasible(const ProfileSpec& spec)
+{
+  double entry = spec.entry_rate;
+  double exit = spec.exit_rate;
+  return std::fabs(entry*entry - exit*exit) <= 2.0*spec.acc*spec.steps;
+}
+
+
+double ProfileAnalyzer::ideal_time(const ProfileSpec& spec)
+{
+  double entry, exit;
+  reachable_rates(spec, entry, exit);
+  double peak = std::sqrt((2.0*spec.acc*spec.steps +
+			   entry*entry + exit*exit)/2);
+  peak = std::min(peak, double(spec.nominal_rate));
+
+  double ramp_steps = (2*peak*peak - entry*entry - exit*exit)/(2*spec.acc);
+  double cruise_steps = std::max(spec.steps - ramp_steps, 0.0);
+  return (2*peak - entry - exit)/spec.acc + cruise_steps/spec.nominal_rate;
+}
+
+
+void ProfileAnalyzer::exact_times(const ProfileSpec& spec,
+				  float timer_frequency,
+				  std::vector<double>& times)
+{
+  float f = timer_frequency;
+  TrapezoidParameters params(spec.steps, spec.entry_rate, spec.exit_rate,
+			     spec.nominal_rate, f, spec.acc);
+  double q = 2.0*f*f/spec.acc;
+  std::uint32_t to_exit = std::floor(spec.exit_rate*spec.exit_rate/
+				     (2.0f*spec.acc));
+  std::uint32_t exit_n = to_exit + spec.steps - params.decelerateAfter;
+
+  times.resize(spec.steps + 1);
+  for (std::uint32_t event = 0; event <= spec.steps; event++) {
+    if (event <= params.accelerateUntil) {
+      times[event] = std::sqrt(q*(params.n0 + event)) -
+	std::sqrt(q*params.n0);
+    }
+    else if (event <= params.decelerateAfter) {
+      times[event] = times[params.accelerateUntil] +
+	(event - params.accelerateUntil)*double(f)/spec.nominal_rate;
+    }
+    else {
+      times[event] = times[params.decelerateAfter] + std::sqrt(q*exit_n) -
+	std::sqrt(q*(exit_n - (event - params.decelerateAfter)));
+    }
+  }
+}
+
+
+const ProfileReport& ProfileAnalyzer::analyze_delays(const ProfileSpec& spec)
+{
+  report = ProfileReport();
+  points.clear();
+
+  // Rates are the same for all steps
+  double entry, exit;
+  reachable_rates(spec, entry, exit);
+
+  double ticks = 0;
+  double last_velocity = 0;
+  double last_time = 0;
+  for (std::uint32_t step = 0; step < delays.size(); ++step) {
+    double delay = delays[step];
+    double velocity = timer_frequency/delay;
+    double time = (ticks + delay/2)/timer_frequency;
+    double ideal = std::sqrt(ideal_velocity_sqr(spec, entry, exit,
+						step + 0.5));
+
+    double error = std::fabs(velocity - ideal)/spec.nominal_rate;
+    report.peak_velocity_error = std::max(report.peak_velocity_error, error);
+
+    if (step > 0) {
+      double acceleration = (velocity - last_velocity)/(time - last_time);
+      report.peak_acceleration = std::max(report.peak_acceleration,
+					  std::fabs(acceleration)/spec.acc);
+      if (record_curves) {
+	points.back().acceleration = acceleration;
+      }
+    }
+    if (record_curves) {
+      points.push_back(CurvePoint{time, velocity, ideal, 0});
+    }
+
+    ticks += delay;
+    last_velocity = velocity;
+    last_time = time;
+  }
+
+  report.total_time = ticks/timer_frequency;
+  report.ideal_time = ideal_time(spec);
+  if (report.ideal_time > 0) {
+    report.time_error = (report.total_time - report.ideal_time)/
+      report.ideal_time;
+  }
+
+  if (spec.entry_rate == spec.exit_rate) {
+    std::size_t count = delays.size();
+    for (std::size_t step = 0; step < count/2; ++step) {
+      std::uint32_t a = delays[step];
+      std::uint32_t b = delays[count - 1 - step];
+      report.max_asymmetry = std::max(report.max_asymmetry,
+				      a > b ? a - b : b - a);
+    }
+  }
+  return report;
+}
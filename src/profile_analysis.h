@@ -0,0 +1,122 @@
+#ifndef PROFILE_ANALYSIS_H
+#define PROFILE_ANALYSIS_H
+
+#include <cstdint>
+#include <vector>
+#include "trapezoid_generator.h"
+
+/// Requested trapezoid, rates in steps/s and acceleration in steps/s^2
+struct ProfileSpec {
+  std::uint32_t steps;
+  float entry_rate;
+  float exit_rate;
+  float nominal_rate;
+  float acc;
+};
+
+/// Realized profile compared with the analytic trapezoid
+struct ProfileReport {
+  /// Sum of all delays in seconds
+  double total_time;
+  /// Time of the analytic trapezoid in seconds
+  double ideal_time;
+  /// (total_time - ideal_time)/ideal_time
+  double time_error;
+  /// Largest velocity difference relative to nominal rate
+  double peak_velocity_error;
+  /// Largest realized acceleration relative to requested
+  double peak_acceleration;
+  /// Largest delay difference in ticks between mirrored steps, when
+  /// entry and exit rates are equal, otherwise 0
+  std::uint32_t max_asymmetry;
+};
+
+/// Runs trapezoid generators to completion and analyzes the delays.
+/**
+   Realized velocity of a step is the inverse of its delay, placed
+   half a step after the step. The analytic trapezoid is evaluated at
+   the same position: v(s) = min(sqrt(entry^2 + 2as), nominal,
+   sqrt(exit^2 + 2a(steps - s))). Realized acceleration is the
+   velocity difference of consecutive steps over their time difference.
+
+   Buffers are reused between calls, so one analyzer per thread can
+   process many profiles without allocation.
+ */
+class ProfileAnalyzer {
+ public:
+  /// Point of the realized curves, one per step
+  struct CurvePoint {
+    /// Time of middle of step in seconds
+    double time;
+    double velocity;
+    double ideal_velocity;
+    /// Acceleration between this and the next step
+    double acceleration;
+  };
+
+  /// @param timer_frequency in Hz
+  explicit ProfileAnalyzer(float timer_frequency);
+
+  /// Keep velocity and acceleration curves of the last analysis
+  void set_record_curves(bool record) {
+    record_curves = record;
+  }
+
+  /// Analyze profile with TrapezoidGenerator
+  const ProfileReport& analyze(const ProfileSpec& spec) {
+    TrapezoidParameters params(spec.steps, spec.entry_rate, spec.exit_rate,
+			       spec.nominal_rate, timer_frequency, spec.acc);
+    return analyze(spec, TrapezoidGenerator(params));
+  }
+
+  /// Analyze profile produced by generator, made from spec.
+  template <class Generator>
+  const ProfileReport& analyze(const ProfileSpec& spec, Generator generator) {
+    delays.clear();
+    while (!generator.is_done()) {
+      delays.push_back(generator.next_delay());
+    }
+    return analyze_delays(spec);
+  }
+
+  /// Delays of the last analysis
+  const std::vector<std::uint32_t>& last_delays() const {
+    return delays;
+  }
+
+  /// Curves of the last analysis, if recorded
+  const std::vector<CurvePoint>& curve() const {
+    return points;
+  }
+
+  /// Velocity in steps/s of analytic trapezoid after s steps
+  static double ideal_velocity(const ProfileSpec& spec, double s);
+
+  /// Time in seconds of analytic trapezoid
+  static double ideal_time(const ProfileSpec& spec);
+
+  /// True if exit rate can be reached from entry rate within steps.
+  /** Infeasible specs are never produced by the planner, and the
+      generators only approximate them.
+   */
+  static bool is_feasible(const ProfileSpec& spec);
+
+  /// Exact event times in timer ticks, times[0] is 0.
+  /** The trapezoid ExactTrapezoidGenerator follows: ramps are at the
+      step positions of TrapezoidParameters, and ramp events are timed
+      from the virtual steps from rest.
+   */
+  static void exact_times(const ProfileSpec& spec, float timer_frequency,
+			  std::vector<double>& times);
+
+ private:
+  const ProfileReport& analyze_delays(const ProfileSpec& spec);
+
+  float timer_frequency;
+  bool record_curves;
+  std::vector<std::uint32_t> delays;
+  std::vector<CurvePoint> points;
+  ProfileReport report;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdint.h>
+
+/// Single producer, single consumer byte queue.
+/**
+   Indices are single bytes, so on an 8-bit target they are read and
+   written atomically and the buffer can be shared between an
+   interrupt and the main loop without disabling interrupts, as long
+   as only one side pushes and only the other side pops.
+
+   Size must be a power of two, at most 256. One slot is kept empty to
+   tell a full buffer from an empty one, so Size-1 bytes can be stored.
+ */
+template <unsigned Size>
+class RingBuffer {
+  static_assert(Size >= 2 && Size <= 256 && (Size & (Size - 1)) == 0,
+		"RingBuffer size must be a power of two, at most 256");
+ public:
+  RingBuffer()
+    : head(0)
+    , tail(0)
+  {
+  }
+
+  /// Add byte to buffer, returns false if full
+  bool push(uint8_t byte) {
+    uint8_t next = (head + 1) & mask;
+    if (next == tail) {
+      return false;
+    }
+    data[head] = byte;
+    head = next;
+    return true;
+  }
+
+  /// Remove oldest byte from buffer, returns false if empty
+  bool pop(uint8_t& byte) {
+    if (head == tail) {
+      return false;
+    }
+    byte = data[tail];
+    tail = (tail + 1) & mask;
+    return true;
+  }
+
+  /// Look at byte offset positions from oldest without removing it.
+  /** Offset must be less than size().
+   */
+  uint8_t peek(uint8_t offset = 0) const {
+    return data[(tail + offset) & mask];
+  }
+
+  /// Number of stored bytes
+  uint8_t size() const {
+    return (head - tail) & mask;
+  }
+
+  /// Number of bytes that can be pushed
+  uint8_t free() const {
+    return mask - size();
+  }
+
+  bool is_empty() const {
+    return head == tail;
+  }
+
+  bool is_full() const {
+    return ((head + 1) & mask) == tail;
+  }
+
+  /// Number of bytes that can be stored
+  static uint8_t capacity() {
+    return mask;
+  }
+
+ private:
+  static const uint8_t mask = Size - 1;
+
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  uint8_t data[Size];
+};
+
+#endif
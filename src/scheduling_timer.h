@@ -3,15 +3,17 @@
 
 #include <stdint.h>
 
-/// 
+/// Task run by SchedulingTimer
 /**
-   
+   Holds the scheduled timestamp and the bookkeeping of the queue
+   policy, so no memory is allocated when scheduling.
  */
 class Schedulable {
  protected:
   Schedulable()
     : timestamp(0)
     , next(nullptr)
+    , index(0)
   {
   }
 
@@ -26,11 +28,199 @@ class Schedulable {
     return timestamp;
   }
  private:
-  template <class Base>
+  template <class Base, class Queue>
   friend class SchedulingTimer;
+  friend class ListQueue;
+  template <uint8_t Capacity>
+  friend class HeapQueue;
+
+  /// Returns true if timestamp a is after b, modulo 2^16
+  static bool is_after(uint16_t a, uint16_t b) {
+    return static_cast<int16_t>(a - b) > 0;
+  }
 
   uint16_t timestamp;
+  /// Next in ListQueue
   Schedulable *next;
+  /// Position in HeapQueue
+  uint8_t index;
+};
+
+/// Queue policy of SchedulingTimer, sorted linked list.
+/**
+   Insert and remove walk the list, O(n), but the list needs no
+   storage besides the Schedulables. Equal timestamps run in the
+   order they were scheduled.
+ */
+class ListQueue {
+ public:
+  ListQueue()
+    : head(nullptr)
+  {
+  }
+
+  /// Earliest Schedulable, nullptr if empty
+  Schedulable *top() const {
+    return head;
+  }
+
+  /// Remove top(), queue must not be empty
+  void pop() {
+    head = head->next;
+  }
+
+  /// Add or move sched to sched->timestamp, always succeeds
+  bool insert(Schedulable *sched) {
+    remove(sched);
+
+    Schedulable *prev = nullptr;
+    Schedulable *current = head;
+    while (current && Schedulable::is_after(sched->timestamp,
+					    current->timestamp)) {
+      prev = current;
+      current = current->next;
+    }
+
+    if (!prev) {
+      head = sched;
+    }
+    else {
+      prev->next = sched;
+    }
+    sched->next = current;
+    return true;
+  }
+
+  /// Remove sched if queued
+  void remove(Schedulable *sched) {
+    Schedulable *prev = nullptr;
+    for (Schedulable *current = head; current; current = current->next) {
+      if (current == sched) {
+	if (prev) {
+	  prev->next = sched->next;
+	}
+	else {
+	  head = sched->next;
+	}
+	return;
+      }
+      prev = current;
+    }
+  }
+
+ private:
+  Schedulable *head;
+};
+
+/// Queue policy of SchedulingTimer, binary min-heap.
+/**
+   Insert and remove are O(log Capacity), which bounds the time
+   interrupts are disabled regardless of the number of tasks. At most
+   Capacity Schedulables can be queued. Equal timestamps run in no
+   particular order.
+ */
+template <uint8_t Capacity>
+class HeapQueue {
+  static_assert(Capacity >= 1, "HeapQueue needs capacity");
+ public:
+  HeapQueue()
+    : size(0)
+  {
+  }
+
+  /// Earliest Schedulable, nullptr if empty
+  Schedulable *top() const {
+    return size ? heap[0] : nullptr;
+  }
+
+  /// Remove top(), queue must not be empty
+  void pop() {
+    remove_at(0);
+  }
+
+  /// Add or move sched to sched->timestamp, false if full
+  bool insert(Schedulable *sched) {
+    if (contains(sched)) {
+      uint8_t index = sched->index;
+      sift_up(index);
+      sift_down(sched->index);
+      return true;
+    }
+    if (size == Capacity) {
+      return false;
+    }
+    place(sched, size++);
+    sift_up(size - 1);
+    return true;
+  }
+
+  /// Remove sched if queued
+  void remove(Schedulable *sched) {
+    if (contains(sched)) {
+      remove_at(sched->index);
+    }
+  }
+
+ private:
+  bool contains(Schedulable *sched) const {
+    return sched->index < size && heap[sched->index] == sched;
+  }
+
+  void place(Schedulable *sched, uint8_t index) {
+    heap[index] = sched;
+    sched->index = index;
+  }
+
+  void remove_at(uint8_t index) {
+    --size;
+    if (index != size) {
+      Schedulable *moved = heap[size];
+      place(moved, index);
+      sift_up(index);
+      sift_down(moved->index);
+    }
+  }
+
+  bool is_before(uint8_t a, uint8_t b) const {
+    return Schedulable::is_after(heap[b]->timestamp, heap[a]->timestamp);
+  }
+
+  void swap(uint8_t a, uint8_t b) {
+    Schedulable *sched = heap[a];
+    place(heap[b], a);
+    place(sched, b);
+  }
+
+  void sift_up(uint8_t index) {
+    while (index > 0) {
+      uint8_t parent = (index - 1)/2;
+      if (!is_before(index, parent)) {
+	break;
+      }
+      swap(index, parent);
+      index = parent;
+    }
+  }
+
+  void sift_down(uint8_t index) {
+    while (true) {
+      unsigned child = 2*index + 1;
+      if (child >= size) {
+	break;
+      }
+      if (child + 1 < size && is_before(child + 1, child)) {
+	child++;
+      }
+      if (!is_before(child, index)) {
+	break;
+      }
+      swap(index, child);
+      index = child;
+    }
+  }
+
+  Schedulable *heap[Capacity];
+  uint8_t size;
 };
 
 /**
@@ -69,14 +259,18 @@ void enable_interrupts();
 
 
 \code
- * 
+ *
+ * template parameter Queue orders the scheduled Schedulables, and is
+ * ListQueue or HeapQueue<Capacity>. The queue is only modified with
+ * interrupts disabled, so HeapQueue bounds the interrupt-off time.
+ * Timestamps are compared modulo 2^16, so pending timestamps must be
+ * less than 2^15 ticks from now.
  */
-template <class TimerBase>
+template <class TimerBase, class Queue = ListQueue>
 class SchedulingTimer : public TimerCallback {
  public:
   
   SchedulingTimer()
-    : head(nullptr)
   {
     base.set_callback(this);
   }
@@ -86,70 +280,57 @@ class SchedulingTimer : public TimerCallback {
   }
 
   /**
-   * Schedule block to run at timestamp
+   * Schedule block to run at timestamp, or move it if scheduled
+   * @returns false if the queue is full, see HeapQueue
    */
-  void schedule(Schedulable *sched, uint16_t timestamp) {
+  bool schedule(Schedulable *sched, uint16_t timestamp) {
     base.disable_interrupts();
 
-    Schedulable *prev = nullptr;
-    Schedulable *current = head;
-    while(current && static_cast<int32_t>(timestamp - current->timestamp) > 0)
-    {
-      prev = current;
-      current = current->next;
-    }
-
-    if (!prev) {
-      head = sched;
-      base.start_timer(timestamp);
-    }
-    else {
-      prev->next = sched;
-    }
-
-    sched->next = current;
+    Schedulable *first = queue.top();
     sched->timestamp = timestamp;
+    bool queued = queue.insert(sched);
+    if (queue.top() != first || first == sched) {
+      // Earliest timestamp changed
+      base.start_timer(queue.top()->timestamp);
+    }
 
     base.enable_interrupts();
+    return queued;
   }
 
 
   void remove(Schedulable *sched) {
     base.disable_interrupts();
-    if (head == sched) {
-      head = sched->next;
-      base.start_timer(head->timestamp);
+    if (queue.top() == sched) {
+      queue.pop();
+      if (Schedulable *first = queue.top()) {
+	base.start_timer(first->timestamp);
+      }
+      else {
+	base.stop_timer();
+      }
     }
     else {
-      Schedulable *last = head;
-      Schedulable *current = head->next;
-      while(current) {
-	if (current == sched) {
-	  last->next = sched->next;
-	  break;
-	}
-	last = current;
-	current = current->next;
-      }
+      queue.remove(sched);
     }
     base.enable_interrupts();
   }
 
   void on_timer() {
     while(true) {
-      if (!head) {
+      Schedulable *first = queue.top();
+      if (!first) {
 	base.stop_timer();
 	return;
       }
       
-      if (static_cast<int32_t>(head->timestamp - 
-			       base.current_timestamp()) <= 0) {
-	Schedulable *current = head;
-	head = head->next;
-	current->on_timer();
+      if (!Schedulable::is_after(first->timestamp,
+				 base.current_timestamp())) {
+	queue.pop();
+	first->on_timer();
       }
       else {
-	base.start_timer(head->timestamp);
+	base.start_timer(first->timestamp);
 	return;
       }
     }
@@ -161,7 +342,7 @@ class SchedulingTimer : public TimerCallback {
   }
  private:
   TimerBase base;
-  Schedulable *head;
+  Queue queue;
 };
 
 #endif
@@ -0,0 +1,160 @@
+#ifndef STATIC_STEPPER_H
+#define STATIC_STEPPER_H
+
+#include <stdint.h>
+#include "stepper.h"
+
+/** Stepper with pins chosen at compile time.
+
+    Same behaviour and interface as Stepper, but each pin is a type with
+    static set(), clear() and get(), like FastPin in avr/fast_pin.h.
+    There are no virtual calls and no pin numbers stored, so on AVR
+    step() and unstep() compile to single sbi/cbi instructions plus the
+    state and position bookkeeping.
+ */
+template <class EnablePin, class StepPin, class DirPin, class EndstopPin>
+class StaticStepper {
+ public:
+  typedef Stepper::State State;
+
+  StaticStepper()
+    : position_(0)
+    , state_(State::DISABLED)
+    , direction_(true)
+    , stop_on_endstop_(true)
+    , endstop_interrupt_(false)
+    , endstop_triggered_(false)
+    , trigger_position_(0)
+  {
+    EnablePin::clear();
+    StepPin::clear();
+    DirPin::clear();
+  }
+
+  /// Return current state
+  State state() const {
+    return state_;
+  }
+
+  /// Disable motor (power off)
+  void disable() {
+    EnablePin::clear();
+    state_ = State::DISABLED;
+  }
+
+  /// Enable motor (power on)
+  void enable() {
+    EnablePin::set();
+    state_ = State::ACTIVE;
+  }
+
+  /// Set direction, see Stepper::set_direction()
+  void set_direction(bool positive) {
+    if (positive) {
+      DirPin::set();
+    }
+    else {
+      DirPin::clear();
+    }
+    direction_ = positive;
+  }
+
+  /// Do one step if in state ACTIVE
+  void step() {
+    if (state_ == State::ACTIVE) {
+      StepPin::set();
+      position_ += direction_?1:-1;
+      state_ = State::STEPPING;
+    }
+  }
+
+  /// Release step, see Stepper::unstep()
+  void unstep() {
+    if (state_ == State::STEPPING) {
+      StepPin::clear();
+      if (!stop_on_endstop_) {
+	state_ = State::ACTIVE;
+      }
+      else if (endstop_interrupt_) {
+	state_ = endstop_triggered_ ? State::STOPPED : State::ACTIVE;
+      }
+      else if (EndstopPin::get()) {
+	latch_endstop();
+	state_ = State::STOPPED;
+      }
+      else {
+	state_ = State::ACTIVE;
+      }
+    }
+  }
+
+  /// Check if endstop is currently active
+  bool is_endstop_active() const {
+    return EndstopPin::get();
+  }
+
+  /// Select behaviour on endstop, see Stepper::stop_on_endstop()
+  void stop_on_endstop(bool stop) {
+    stop_on_endstop_ = stop;
+  }
+
+  /// Select how endstop triggers are detected, see Stepper
+  void use_endstop_interrupt(bool use) {
+    endstop_interrupt_ = use;
+    if (use && EndstopPin::get()) {
+      on_endstop();
+    }
+  }
+
+  /// Endstop became active, see Stepper::on_endstop()
+  void on_endstop() {
+    latch_endstop();
+    if (stop_on_endstop_ && state_ == State::ACTIVE) {
+      state_ = State::STOPPED;
+    }
+  }
+
+  bool is_endstop_triggered() const {
+    return endstop_triggered_;
+  }
+
+  int trigger_position() const {
+    return trigger_position_;
+  }
+
+  /// Rearm trigger, see Stepper::clear_endstop_trigger()
+  void clear_endstop_trigger() {
+    endstop_triggered_ = false;
+    if (endstop_interrupt_ && EndstopPin::get()) {
+      on_endstop();
+    }
+  }
+
+  /// Set current position
+  void set_position(int position) {
+    position_ = position;
+  }
+
+  /// Get current position
+  int position() const {
+    return position_;
+  }
+
+ private:
+  void latch_endstop() {
+    if (!endstop_triggered_) {
+      trigger_position_ = position_;
+      endstop_triggered_ = true;
+    }
+  }
+
+  int32_t position_;
+  State state_;
+  bool direction_;
+  bool stop_on_endstop_;
+  bool endstop_interrupt_;
+  volatile bool endstop_triggered_;
+  volatile int32_t trigger_position_;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "step_producer.h"
+#include "planner.h"
+#include "trapezoid_ticker.h"
+#include <cmath>
+#include <cstdlib>
+
+StepProducer::StepProducer(const std::vector<StepQueue*>& queues,
+			   float frequency,
+			   std::uint32_t tolerance)
+  : queues(queues)
+  , bresenhams(queues.size())
+  , directions(queues.size(), true)
+  , last_step(queues.size(), 0)
+  , frequency(frequency)
+  , time(0)
+  , delay_residue(0)
+{
+  for (auto queue : queues) {
+    compressors.push_back(StepCompressor(queue, tolerance));
+  }
+}
+
+
+void StepProducer::reset_time()
+{
+  time = 0;
+  delay_residue = 0;
+  last_step.assign(last_step.size(), 0);
+}
+
+
+bool StepProducer::fill(Planner *planner)
+{
+  while (true) {
+    // Each event pushes at most one run per queue
+    if (is_any_queue_full()) {
+      return false;
+    }
+
+    if (trapezoid.is_done() && !setup_next_move(planner)) {
+      for (auto& compressor : compressors) {
+	compressor.flush();
+      }
+      return true;
+    }
+
+    for (unsigned ind = 0; ind < queues.size(); ++ind) {
+      if (bresenhams[ind].tick()) {
+	compressors[ind].push(time - last_step[ind], directions[ind]);
+	last_step[ind] = time;
+      }
+    }
+    time += trapezoid.next_delay();
+  }
+}
+
+
+bool StepProducer::setup_next_move(Planner *planner)
+{
+  while (const Move *move = planner->get_current_move()) {
+    float entry_speed = std::sqrt(planner->get_current_entry_speed_sqr());
+    float exit_speed = std::sqrt(planner->get_current_exit_speed_sqr());
+    TrapezoidTicker::Profile profile =
+      TrapezoidTicker::make_profile(*move, entry_speed, exit_speed,
+				    frequency);
+    if (profile.events == 0) {
+      planner->next_move();
+      continue;
+    }
+    profile.trapezoid.carry_fraction(delay_residue);
+    trapezoid = TrapezoidGenerator(profile.trapezoid);
+
+    for (unsigned ind = 0; ind < queues.size(); ind++) {
+      directions[ind] = move->steps[ind] > 0;
+      bresenhams[ind] = Bresenham(std::abs(move->steps[ind]),
+				  profile.events, 1);
+    }
+    planner->next_move();
+    return true;
+  }
+  return false;
+}
+
+
+bool StepProducer::is_any_queue_full() const
+{
+  for (auto queue : queues) {
+    if (queue->is_full()) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,53 @@
+#ifndef STEP_PRODUCER_H
+#define STEP_PRODUCER_H
+
+#include <vector>
+#include "bresenham.h"
+#include "step_queue.h"
+#include "trapezoid_generator.h"
+
+class Planner;
+
+/// Fills StepQueues with compressed step timing for planned moves.
+/**
+   Runs the same trapezoid and Bresenham algorithms as TrapezoidTicker,
+   but from the main loop instead of the timer interrupt. The resulting
+   step times of each stepper are compressed into StepRuns for
+   StepQueueTicker.
+ */
+class StepProducer {
+ public:
+  /// One queue per stepper
+  /** @param frequency timer frequency in Hz
+      @param tolerance max deviation in timer ticks for compressed steps
+   */
+  StepProducer(const std::vector<StepQueue*>& queues,
+	       float frequency,
+	       std::uint32_t tolerance);
+
+  /// Produce steps until a queue is full or no moves are left.
+  /** Completed moves are removed from planner.
+      @returns true when all planned moves have been queued.
+  */
+  bool fill(Planner *planner);
+
+  /// Restart time base, for when the ticker is started again
+  void reset_time();
+
+ private:
+  bool setup_next_move(Planner *planner);
+  bool is_any_queue_full() const;
+
+  std::vector<StepQueue*> queues;
+  std::vector<StepCompressor> compressors;
+  std::vector<Bresenham> bresenhams;
+  std::vector<bool> directions;
+  std::vector<std::uint32_t> last_step;
+  TrapezoidGenerator trapezoid;
+  float frequency;
+  std::uint32_t time;
+  /// Rounding error of first delays carried between moves
+  std::int16_t delay_residue;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "step_queue.h"
+#include <algorithm>
+#include <limits>
+
+StepQueue::StepQueue(unsigned size)
+  : runs(size)
+  , head(0)
+  , tail(0)
+{
+}
+
+
+bool StepQueue::push(const StepRun& run)
+{
+  std::size_t next = next_index(head);
+  if (next == tail) {
+    return false;
+  }
+  runs[head] = run;
+  head = next;
+  return true;
+}
+
+
+const StepRun* StepQueue::front() const
+{
+  if (head == tail) {
+    return nullptr;
+  }
+  return &runs[tail];
+}
+
+
+void StepQueue::pop()
+{
+  if (head != tail) {
+    tail = next_index(tail);
+  }
+}
+
+
+bool StepQueue::is_full() const
+{
+  return next_index(head) == tail;
+}
+
+
+bool StepQueue::is_empty() const
+{
+  return head == tail;
+}
+
+
+std::size_t StepQueue::next_index(std::size_t index) const
+{
+  index++;
+  if (index == runs.size()) {
+    index = 0;
+  }
+  return index;
+}
+
+
+namespace {
+  std::int64_t floor_div(std::int64_t num, std::int64_t den) {
+    std::int64_t q = num/den;
+    return (num % den != 0 && num < 0) ? q - 1 : q;
+  }
+
+  std::int64_t ceil_div(std::int64_t num, std::int64_t den) {
+    std::int64_t q = num/den;
+    return (num % den != 0 && num > 0) ? q + 1 : q;
+  }
+}
+
+
+StepCompressor::StepCompressor(StepQueue *queue, std::uint32_t tolerance)
+  : queue(queue)
+  , tolerance(tolerance)
+  , requested(0)
+  , add_min(0)
+  , add_max(0)
+  , deviation(0)
+  , runs_(0)
+{
+  run.count = 0;
+}
+
+
+void StepCompressor::push(std::uint32_t interval, bool direction)
+{
+  if (run.count == 0) {
+    start(interval, direction);
+    return;
+  }
+
+  if (direction == run.direction &&
+      run.count < std::numeric_limits<std::uint16_t>::max()) {
+    // Step k is predicted at (k+1)*interval + add*k*(k+1)/2
+    std::int64_t k = run.count;
+    std::int64_t time = requested + interval;
+    std::int64_t base = (k + 1)*run.interval;
+    std::int64_t den = k*(k + 1)/2;
+
+    std::int64_t lo = std::max(add_min,
+			       ceil_div(time - tolerance - base, den));
+    std::int64_t hi = std::min(add_max,
+			       floor_div(time + tolerance - base, den));
+    // Keep all intervals positive
+    lo = std::max(lo, ceil_div(1 - static_cast<std::int64_t>(run.interval), k));
+
+    if (lo <= hi) {
+      run.count++;
+      requested = time;
+      add_min = lo;
+      add_max = hi;
+      return;
+    }
+  }
+
+  flush();
+  start(interval, direction);
+}
+
+
+void StepCompressor::flush()
+{
+  if (run.count > 0) {
+    std::int64_t k = run.count - 1;
+    run.add = run.count > 1 ? (add_min + add_max)/2 : 0;
+    std::int64_t predicted = (k + 1)*run.interval + run.add*k*(k + 1)/2;
+    deviation = predicted - requested;
+
+    queue->push(run);
+    runs_++;
+    run.count = 0;
+  }
+}
+
+
+void StepCompressor::start(std::uint32_t interval, bool direction)
+{
+  // Compensate for deviation of previous run
+  requested = static_cast<std::int64_t>(interval) - deviation;
+  run.interval = requested < 1 ? 1 : requested;
+  run.count = 1;
+  run.add = 0;
+  run.direction = direction;
+  add_min = std::numeric_limits<std::int16_t>::min();
+  add_max = std::numeric_limits<std::int16_t>::max();
+}
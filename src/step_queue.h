@@ -0,0 +1,88 @@
+#ifndef STEP_QUEUE_H
+#define STEP_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+/// Sequence of steps in one direction with linearly changing interval.
+/** Step k, 0 <= k < count, occurs interval + k*add timer ticks
+    after the previous step.
+ */
+struct StepRun {
+  std::uint32_t interval;
+  std::uint16_t count;
+  std::int16_t add;
+  bool direction;
+};
+
+/// Queue of StepRuns for one stepper.
+/**
+   Filled from main loop, consumed from interrupt context.
+   Single producer, single consumer.
+ */
+class StepQueue {
+ public:
+  /// Create queue holding at most size-1 runs
+  explicit StepQueue(unsigned size);
+
+  bool push(const StepRun& run);
+
+  /// Returns oldest run or nullptr if empty
+  const StepRun* front() const;
+
+  /// Discard oldest run
+  void pop();
+
+  bool is_full() const;
+  bool is_empty() const;
+
+ private:
+  std::size_t next_index(std::size_t index) const;
+
+  std::vector<StepRun> runs;
+  volatile std::size_t head;
+  volatile std::size_t tail;
+};
+
+/// Compresses a stream of step intervals into StepRuns.
+/**
+   Steps are appended to the current run as long as some value of add
+   makes the run predict every step time within tolerance ticks of the
+   requested time. The range of such values is narrowed with each
+   step, so this is O(1) per step without storing the steps. Deviation
+   left when a run is closed is carried over to the next run, so
+   errors do not accumulate.
+ */
+class StepCompressor {
+ public:
+  StepCompressor(StepQueue *queue, std::uint32_t tolerance);
+
+  /// Add step interval ticks after previous step.
+  /** May push a completed run, the queue must not be full.
+   */
+  void push(std::uint32_t interval, bool direction);
+
+  /// Push pending run, if any. The queue must not be full.
+  void flush();
+
+  /// Number of runs pushed
+  std::uint32_t runs() const {
+    return runs_;
+  }
+
+ private:
+  void start(std::uint32_t interval, bool direction);
+
+  StepQueue *queue;
+  std::int64_t tolerance;
+  StepRun run;
+  /// Requested time of last step, relative to predicted start of run
+  std::int64_t requested;
+  /// Range of add keeping all steps in run within tolerance
+  std::int64_t add_min, add_max;
+  /// Predicted minus requested time of last step of previous run
+  std::int64_t deviation;
+  std::uint32_t runs_;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "step_queue_ticker.h"
+#include <cassert>
+
+const unsigned StepQueueTicker::max_axes;
+
+StepQueueTicker::StepQueueTicker(StepperGroup *steppers,
+				 const std::vector<StepQueue*>& queues,
+				 Timer *timer)
+  : timer(timer)
+  , steppers(steppers)
+  , queues(queues)
+  , runs()
+  , loaded(0)
+  , due(0)
+  , directions(0)
+  , now(0)
+  , running(false)
+  , step_duration(static_cast<uint32_t>(10e-6f * timer->frequency()))
+  , pulse_width(static_cast<uint32_t>(2e-6f * timer->frequency()))
+{
+  assert(queues.size() == steppers->size());
+}
+
+
+void StepQueueTicker::start()
+{
+  if (!running) {
+    now = 0;
+    for (auto& run : runs) {
+      // First steps after the direction setup time, as TrapezoidTicker
+      run.time = step_duration;
+    }
+    loaded = 0;
+    due = 0;
+    directions = steppers->directions();
+    running = true;
+    timer->start(this);
+  }
+}
+
+
+bool StepQueueTicker::load(unsigned axis)
+{
+  const StepRun *next = queues[axis]->front();
+  if (!next) {
+    return false;
+  }
+
+  Run& run = runs[axis];
+  run.interval = next->interval;
+  run.add = next->add;
+  run.remaining = next->count - 1;
+  run.time += next->interval;
+  StepperGroup::Mask bit = 1 << axis;
+  if (next->direction) {
+    directions |= bit;
+  }
+  else {
+    directions &= ~bit;
+  }
+  loaded |= bit;
+  queues[axis]->pop();
+  return true;
+}
+
+
+void StepQueueTicker::hold(std::uint32_t since) {
+  std::uint32_t elapsed = timer->timestamp() - since;
+  if (elapsed < pulse_width) {
+    timer->wait(pulse_width - elapsed);
+  }
+}
+
+
+std::uint32_t StepQueueTicker::on_timer()
+{
+  std::uint32_t start = timer->timestamp();
+  if (due) {
+    steppers->step(due);
+    // Shifted masks, as in StepperGroup
+    StepperGroup::Mask left = due;
+    for (unsigned axis = 0; left; ++axis, left >>= 1) {
+      if (left & 1) {
+	Run& run = runs[axis];
+	if (run.remaining > 0) {
+	  run.remaining--;
+	  run.interval += run.add;
+	  run.time += run.interval;
+	}
+	else {
+	  // Next run is loaded after unstep, its direction may differ
+	  loaded &= ~(1 << axis);
+	}
+      }
+    }
+    hold(start);
+    steppers->unstep();
+  }
+
+  unsigned axes = steppers->size();
+  StepperGroup::Mask all = (1u << axes) - 1;
+  if (loaded != all) {
+    StepperGroup::Mask previous = directions;
+    for (unsigned axis = 0; axis < axes; ++axis) {
+      if (!(loaded & (1 << axis))) {
+	load(axis);
+      }
+    }
+    if (directions != previous) {
+      steppers->set_directions(directions);
+    }
+  }
+
+  if (!loaded) {
+    running = false;
+    due = 0;
+    return 0;
+  }
+
+  // Next event is at least the pulse low time after the release. Late
+  // steps are due at once, with all axes due by then.
+  std::int32_t min_delay = timer->timestamp() - start + pulse_width;
+  std::int32_t delay = 0;
+  StepperGroup::Mask next = 0;
+  StepperGroup::Mask left = loaded;
+  StepperGroup::Mask bit = 1;
+  for (unsigned axis = 0; left; ++axis, left >>= 1, bit <<= 1) {
+    if (left & 1) {
+      std::int32_t until = runs[axis].time - now;
+      if (until < min_delay) {
+	until = min_delay;
+      }
+      if (!next || until < delay) {
+	delay = until;
+	next = bit;
+      }
+      else if (until == delay) {
+	next |= bit;
+      }
+    }
+  }
+
+  due = next;
+  now += delay;
+  return delay;
+}
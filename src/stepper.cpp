@@ -7,6 +7,9 @@ Stepper::Stepper(PinIo *io, Pins pins)
   , state_(State::DISABLED)
   , direction_(true)
   , stop_on_endstop_(true)
+  , endstop_interrupt_(false)
+  , endstop_triggered_(false)
+  , trigger_position_(0)
 {
   io_->clear(pins_.enable);
   io_->clear(pins_.step);
@@ -38,7 +41,14 @@ void Stepper::step() {
 void Stepper::unstep() {
   if (state_ == State::STEPPING) {
     io_->clear(pins_.step);
-    if (stop_on_endstop_ && io_->get(pins_.endstop)) {
+    if (!stop_on_endstop_) {
+      state_ = State::ACTIVE;
+    }
+    else if (endstop_interrupt_) {
+      state_ = endstop_triggered_ ? State::STOPPED : State::ACTIVE;
+    }
+    else if (io_->get(pins_.endstop)) {
+      latch_endstop();
       state_ = State::STOPPED;
     }
     else {
@@ -64,3 +74,32 @@ bool Stepper::is_endstop_active() const {
 void Stepper::stop_on_endstop(bool stop) {
   stop_on_endstop_ = stop;
 }
+
+void Stepper::use_endstop_interrupt(bool use) {
+  endstop_interrupt_ = use;
+  if (use && io_->get(pins_.endstop)) {
+    on_endstop();
+  }
+}
+
+void Stepper::on_endstop() {
+  latch_endstop();
+  if (stop_on_endstop_ && state_ == State::ACTIVE) {
+    state_ = State::STOPPED;
+  }
+}
+
+void Stepper::clear_endstop_trigger() {
+  endstop_triggered_ = false;
+  // An endstop that is already active gives no pin change interrupt
+  if (endstop_interrupt_ && io_->get(pins_.endstop)) {
+    on_endstop();
+  }
+}
+
+void Stepper::latch_endstop() {
+  if (!endstop_triggered_) {
+    trigger_position_ = position_;
+    endstop_triggered_ = true;
+  }
+}
@@ -1,7 +1,7 @@
 #ifndef STEPPER_H
 #define STEPPER_H
 
-#include <cstdint>
+#include <stdint.h>
 #include "pin_io.h"
 
 /** Stepper is a light-weight control of i/o for one stepper motor.
@@ -60,6 +60,41 @@ class Stepper {
    */
   void stop_on_endstop(bool);
 
+  /// Select how endstop triggers are detected.
+  /** If false (default), the endstop pin is read in every unstep().
+      If true, it is not read while stepping, and on_endstop() must be
+      called from a pin change interrupt when the endstop becomes
+      active. An endstop that is already active when switching to
+      interrupts triggers at once, as on_endstop().
+   */
+  void use_endstop_interrupt(bool);
+
+  /// Endstop became active, called from pin change interrupt.
+  /** Latches the trigger and position, and stops the stepper if
+      stop_on_endstop is set. A step in progress is completed by
+      unstep(). The interrupt must not preempt step() or unstep().
+   */
+  void on_endstop();
+
+  /// Returns true if endstop has triggered since clear_endstop_trigger()
+  /** In polling mode a trigger is detected when unstep() stops the
+      stepper.
+   */
+  bool is_endstop_triggered() const {
+    return endstop_triggered_;
+  }
+
+  /// Position when the endstop triggered
+  int trigger_position() const {
+    return trigger_position_;
+  }
+
+  /// Rearm trigger, call before moving towards endstop
+  /** In interrupt mode an endstop that is already active triggers
+      again at once, as there will be no pin change for it.
+   */
+  void clear_endstop_trigger();
+
   /// Set current position
   void set_position(int position) {
     position_ = position;
@@ -71,13 +106,19 @@ class Stepper {
   }
 
  private:
+  /// Record first trigger and its position
+  void latch_endstop();
+
   PinIo *io_;
   Pins pins_;
 
-  std::int32_t position_;
+  int32_t position_;
   State state_;
   bool direction_;
   bool stop_on_endstop_;
+  bool endstop_interrupt_;
+  volatile bool endstop_triggered_;
+  volatile int32_t trigger_position_;
 };
 
 #endif
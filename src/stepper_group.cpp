@@ -0,0 +1,171 @@
+#include "stepper_group.h"
+#include <cassert>
+
+const unsigned StepperGroup::max_axes;
+constexpr PinIo::Pin StepperGroup::no_endstop;
+
+StepperGroup::StepperGroup(PinIo *io, const Stepper::Pins *pins,
+			   unsigned count, Timer *timer,
+			   uint32_t direction_setup)
+  : io(io)
+  , timer(timer)
+  , axes(count)
+  , all((1u << axes) - 1)
+  , with_endstop(0)
+  , direction_setup(direction_setup)
+  , direction_time(0)
+  , setup_pending(false)
+  , endstops()
+  , positions()
+  , trigger_positions()
+  , enabled(0)
+  , stopped(0)
+  , stepping(0)
+  , direction(all)
+  , stop_mask(0)
+  , endstop_direction(all)
+  , interrupt_mask(0)
+  , triggered(0)
+{
+  // Masks and pin sets hold max_axes
+  assert(count <= max_axes);
+  for (unsigned axis = 0; axis < axes; ++axis) {
+    enable_pins.add(pins[axis].enable);
+    step_pins.add(pins[axis].step);
+    dir_pins.add(pins[axis].dir);
+    endstops[axis] = pins[axis].endstop;
+    if (endstops[axis].pin_no != no_endstop.pin_no) {
+      with_endstop |= 1 << axis;
+    }
+  }
+  stop_mask = with_endstop;
+  // A shared enable pin is just set in the same port bit
+  enable_pins.clear(io, all);
+  step_pins.clear(io, all);
+  dir_pins.set(io, all);
+}
+
+StepperGroup::State StepperGroup::state(unsigned axis) const {
+  Mask bit = 1 << axis;
+  if (!(enabled & bit)) {
+    return State::DISABLED;
+  }
+  if (stepping & bit) {
+    return State::STEPPING;
+  }
+  if (stopped & bit) {
+    return State::STOPPED;
+  }
+  return State::ACTIVE;
+}
+
+void StepperGroup::enable() {
+  enable_pins.set(io, all);
+  enabled = all;
+  stopped = 0;
+}
+
+void StepperGroup::disable() {
+  enable_pins.clear(io, all);
+  enabled = 0;
+}
+
+uint32_t StepperGroup::set_directions(Mask positive) {
+  positive &= all;
+  Mask changed = positive ^ direction;
+  direction = positive;
+  if (!changed) {
+    return 0;
+  }
+  dir_pins.write(io, changed, positive);
+  direction_time = timer->timestamp();
+  setup_pending = true;
+  if (Mask approaching = changed & towards_endstop() & stop_mask) {
+    clear_endstop_triggers(approaching);
+  }
+  return direction_setup;
+}
+
+void StepperGroup::step(Mask mask) {
+  Mask steps = mask & active();
+  if (!steps) {
+    return;
+  }
+  if (setup_pending) {
+    uint32_t elapsed = timer->timestamp() - direction_time;
+    if (elapsed < direction_setup) {
+      timer->wait(direction_setup - elapsed);
+    }
+    setup_pending = false;
+  }
+  step_pins.set(io, steps);
+  stepping |= steps;
+  // Shifted masks, as in PinSet
+  Mask positive = direction;
+  for (unsigned axis = 0; steps; ++axis, steps >>= 1, positive >>= 1) {
+    if (steps & 1) {
+      positions[axis] += positive & 1 ? 1 : -1;
+    }
+  }
+}
+
+void StepperGroup::unstep() {
+  if (!stepping) {
+    return;
+  }
+  step_pins.clear(io, stepping);
+
+  Mask checked = stepping & stop_mask & towards_endstop();
+  Mask polled = checked & ~interrupt_mask;
+  for (unsigned axis = 0; polled; ++axis, polled >>= 1) {
+    if ((polled & 1) && io->get(endstops[axis])) {
+      latch_endstop(axis);
+      stopped |= 1 << axis;
+    }
+  }
+  stopped |= checked & interrupt_mask & triggered;
+  stepping = 0;
+}
+
+void StepperGroup::stop_on_endstop(Mask mask) {
+  stop_mask = mask & with_endstop;
+}
+
+void StepperGroup::set_endstop_directions(Mask positive) {
+  endstop_direction = positive & all;
+}
+
+void StepperGroup::use_endstop_interrupt(Mask mask) {
+  interrupt_mask = mask & with_endstop;
+  check_endstops(interrupt_mask);
+}
+
+void StepperGroup::on_endstop(unsigned axis) {
+  latch_endstop(axis);
+  Mask bit = 1 << axis;
+  if (stop_mask & towards_endstop() & active() & bit) {
+    stopped |= bit;
+  }
+}
+
+void StepperGroup::clear_endstop_triggers(Mask mask) {
+  triggered &= ~mask;
+  check_endstops(mask & interrupt_mask);
+}
+
+void StepperGroup::check_endstops(Mask mask) {
+  for (Mask left = mask; left; left &= left - 1) {
+    unsigned axis = __builtin_ctz(left);
+    if (io->get(endstops[axis])) {
+      on_endstop(axis);
+    }
+  }
+}
+
+void StepperGroup::latch_endstop(unsigned axis) {
+  Mask bit = 1 << axis;
+  if (!(triggered & bit)) {
+    trigger_positions[axis] = positions[axis];
+    triggered |= bit;
+  }
+}
@@ -0,0 +1,167 @@
+#ifndef STEPPER_GROUP_H
+#define STEPPER_GROUP_H
+
+#include <stdint.h>
+#include "pin_io.h"
+#include "stepper.h"
+#include "timer.h"
+
+/** Steppers that are stepped together, with state kept per group.
+
+    Behaves like one Stepper per axis, but positions are kept in one
+    array and states and directions as bitmasks, where bit i is axis i.
+    Step, direction and enable pins are written through PinSets, so
+    axes sharing a port change with one mask write. Enable is shared,
+    all axes are enabled and disabled together.
+
+    Steps after a direction change are delayed until the direction
+    setup time has passed on the timer, so callers that do not wait
+    for it still meet the driver timing.
+ */
+class StepperGroup {
+ public:
+  typedef uint8_t Mask;
+  typedef Stepper::State State;
+
+  static const unsigned max_axes = PinSet::max_pins;
+
+  /// Endstop pin of an axis without endstop.
+  /** The axis never stops on an endstop and its endstop is never read.
+   */
+  static constexpr PinIo::Pin no_endstop{0xff};
+
+  /// Group of count axes, more than max_axes is a programming error.
+  /** @param timer clock for the direction setup time
+      @param direction_setup timer ticks needed between a direction
+      change and the next step.
+   */
+  StepperGroup(PinIo *io, const Stepper::Pins *pins, unsigned count,
+	       Timer *timer, uint32_t direction_setup = 1);
+
+  unsigned size() const {
+    return axes;
+  }
+
+  /// State of axis, as Stepper::state()
+  State state(unsigned axis) const;
+
+  /// Power on all motors, stopped axes become active
+  void enable();
+
+  /// Power off all motors
+  void disable();
+
+  /// Set direction of all axes, bit set is positive.
+  /** Only pins that change are written. Axes that turn towards their
+      endstop with stop on endstop get their trigger cleared, as by
+      clear_endstop_triggers(), so each approach has its own trigger.
+      @returns timer ticks to wait before the next step(), 0 if no
+      direction changed.
+   */
+  uint32_t set_directions(Mask positive);
+
+  Mask directions() const {
+    return direction;
+  }
+
+  /// Step axes in mask that are active
+  /** Busy waits what is left of the direction setup time after the
+      last set_directions() that changed a pin.
+   */
+  void step(Mask mask);
+
+  /// Release all steps, stopping axes at endstops
+  void unstep();
+
+  /// Stop axes in mask when their endstop triggers
+  /** Only axes moving towards their endstop stop, so an axis resting
+      on its endstop can still move away from it. Default is all axes
+      with an endstop.
+   */
+  void stop_on_endstop(Mask mask);
+
+  /// Endstops of axes in mask are at the positive end, default all
+  void set_endstop_directions(Mask positive);
+
+  /// Axes in mask get endstop triggers from on_endstop(), see Stepper
+  /** Axes with an active endstop trigger at once.
+   */
+  void use_endstop_interrupt(Mask mask);
+
+  /// Endstop of axis became active, called from pin change interrupt
+  void on_endstop(unsigned axis);
+
+  /// Axes with endstop triggered since clear_endstop_triggers()
+  Mask endstop_triggers() const {
+    return triggered;
+  }
+
+  /// Rearm triggers of axes in mask
+  /** Interrupt axes with an active endstop trigger again at once.
+   */
+  void clear_endstop_triggers(Mask mask);
+
+  /// Position of axis when its endstop triggered
+  int trigger_position(unsigned axis) const {
+    return trigger_positions[axis];
+  }
+
+  bool is_endstop_active(unsigned axis) const {
+    return (with_endstop & (1 << axis)) && io->get(endstops[axis]);
+  }
+
+  void set_position(unsigned axis, int position) {
+    positions[axis] = position;
+  }
+
+  int position(unsigned axis) const {
+    return positions[axis];
+  }
+
+ private:
+  /// Axes that react to step()
+  Mask active() const {
+    return enabled & ~stopped & ~stepping;
+  }
+
+  /// Axes whose direction is towards their endstop
+  Mask towards_endstop() const {
+    return ~(direction ^ endstop_direction) & all;
+  }
+
+  void latch_endstop(unsigned axis);
+
+  /// Trigger interrupt axes in mask whose endstop is already active
+  void check_endstops(Mask mask);
+
+  PinIo *io;
+  Timer *timer;
+  unsigned axes;
+  Mask all;
+  /// Axes whose endstop is not no_endstop
+  Mask with_endstop;
+  uint32_t direction_setup;
+  /// Timestamp of the last direction change
+  uint32_t direction_time;
+  /// Direction setup time has not been checked since the change
+  bool setup_pending;
+
+  PinSet enable_pins;
+  PinSet step_pins;
+  PinSet dir_pins;
+  PinIo::Pin endstops[max_axes];
+
+  int32_t positions[max_axes];
+  volatile int32_t trigger_positions[max_axes];
+
+  Mask enabled;
+  Mask stopped;
+  Mask stepping;
+  Mask direction;
+  Mask stop_mask;
+  Mask endstop_direction;
+  Mask interrupt_mask;
+  volatile Mask triggered;
+};
+
+#endif
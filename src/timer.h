@@ -6,7 +6,7 @@
 class TimerCallback {
  public:
   /// Return requested delay to next call
-  /** counting from start of this call.
+  /** counting from start of this call, see Timer::timestamp().
       If 0 is returned, timer stops.
       The delay value is calculated as requested delay in seconds
       multiplied with frequency() for the associated Timer.
@@ -28,6 +28,24 @@ class Timer {
 
   /// The frequency in Hz for timer delay counter.
   virtual float frequency() const = 0;
+
+  /// Current value of the free running timer counter.
+  /** Wraps around, compare timestamps by the sign of their difference.
+      Callbacks can schedule against absolute timestamps by reading
+      this at the start of on_timer().
+  */
+  virtual std::uint32_t timestamp() const = 0;
+
+  /// Busy wait at least ticks timer ticks.
+  /** For short waits inside a callback, like step pulse widths.
+      Delays returned from on_timer() still count from the start of
+      the call.
+  */
+  virtual void wait(std::uint32_t ticks) {
+    std::uint32_t start = timestamp();
+    while (timestamp() - start <= ticks) {
+    }
+  }
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include "trapezoid_generator.h"
 #include <cmath>
+#include <algorithm>
 
 Ramp::Ramp(std::uint32_t c0, std::int32_t n)
  : c(c0)
@@ -12,12 +13,45 @@ std::uint32_t Ramp::getDelay() {
   return c;
 }
 
+namespace {
+  /// nom/den, and nom%den in remainder, truncating as / and % do.
+  /** Shifts and subtracts over the quotient bits only. After the first
+      ramp steps the quotient has a few bits, so this is a fraction of
+      a full 32 bit division, which is a library call on AVR.
+  */
+  std::int32_t divide(std::int32_t nom, std::int32_t den,
+		      std::int32_t& remainder) {
+    std::uint32_t rest = nom < 0 ? -std::uint32_t(nom) : nom;
+    std::uint32_t divisor = den < 0 ? -std::uint32_t(den) : den;
+    // Align divisor with the highest quotient bit
+    std::uint8_t shift = 0;
+    while (divisor <= rest >> 1) {
+      divisor <<= 1;
+      shift++;
+    }
+    std::uint32_t quotient = 0;
+    for (;;) {
+      quotient <<= 1;
+      if (rest >= divisor) {
+	rest -= divisor;
+	quotient |= 1;
+      }
+      if (!shift) {
+	break;
+      }
+      divisor >>= 1;
+      shift--;
+    }
+    remainder = nom < 0 ? -std::int32_t(rest) : rest;
+    return (nom < 0) != (den < 0) ? -std::int32_t(quotient) : quotient;
+  }
+}
+
 std::uint32_t Ramp::nextDelay() {
   n += 1;
   std::int32_t nom = 2*c + remainder;
   std::int32_t den = 4*n + 1;
-  remainder = nom % den;
-  c -= nom / den;
+  c -= divide(nom, den, remainder);
 
   // Correction to ensure acc and dec ramps are identical
   if (den < 0 && remainder > 0) {
@@ -51,9 +85,12 @@ static std::uint32_t max(std::int32_t a, std::int32_t b) {
 TrapezoidParameters::TrapezoidParameters()
  : steps(0)
  , c0(0)
+ , c0_fraction(0)
+ , first_adjust(0)
  , n0(0)
  , accelerateUntil(0)
  , decelerateAfter(0)
+ , c_nominal(0)
  {}
 
 TrapezoidParameters::TrapezoidParameters(std::uint32_t steps,
@@ -65,10 +102,110 @@ TrapezoidParameters::TrapezoidParameters(std::uint32_t steps,
 {
   // Steps to accelerate from zero to respective speeds
   // Not sure about ceil/floor here
-  std::uint32_t stepsToNominal = floor(acc_steps(nominalRate, acc));
-  std::uint32_t stepsToEntry = floor(acc_steps(entryRate, acc));
-  std::uint32_t stepsToExit = floor(acc_steps(exitRate, acc));
-  
+  set_ramps(steps,
+	    floor(acc_steps(entryRate, acc)),
+	    floor(acc_steps(exitRate, acc)),
+	    floor(acc_steps(nominalRate, acc)));
+
+  // Setup ramp params
+  float c_nominal = timerFreq/nominalRate;
+  float c0;
+  if (n0 == 0) {
+    // Special case for start from zero speed, unless nominal speed is
+    // reached within the first step
+    c0 = std::max(initial_c(timerFreq, acc), c_nominal);
+  }
+  else {
+    c0 = timerFreq/entryRate;
+  }
+  this->c0 = round(c0);
+  this->c0_fraction = round((c0 - this->c0)*256);
+  this->first_adjust = 0;
+  this->c_nominal = round(c_nominal);
+}
+
+namespace {
+  /// Floor of square root
+  std::uint64_t isqrt(std::uint64_t x) {
+    std::uint64_t root = 0;
+    std::uint64_t bit = std::uint64_t(1) << 62;
+    while (bit > x) {
+      bit >>= 2;
+    }
+    while (bit) {
+      if (x >= root + bit) {
+	x -= root + bit;
+	root = (root >> 1) + bit;
+      }
+      else {
+	root >>= 1;
+      }
+      bit >>= 2;
+    }
+    return root;
+  }
+
+  /// floor(v^2/(2*acc)) for v and acc in Q24.8
+  std::uint32_t fixed_acc_steps(std::uint32_t v, std::uint32_t acc) {
+    return std::uint64_t(v)*v / (std::uint64_t(acc) << 9);
+  }
+
+  /// f/rate in Q.8 timer ticks, rounded, for rate in Q24.8
+  std::uint64_t fixed_delay(std::uint32_t f, std::uint32_t rate) {
+    return ((std::uint64_t(f) << 16) + rate/2) / rate;
+  }
+
+  /// 0.676 in Q0.32
+  const std::uint64_t initial_c_factor = 2903397892u;
+}
+
+TrapezoidParameters TrapezoidParameters::from_fixed(std::uint32_t steps,
+						    std::uint32_t entryRate,
+						    std::uint32_t exitRate,
+						    std::uint32_t nominalRate,
+						    std::uint32_t timerFreq,
+						    std::uint32_t acc)
+{
+  TrapezoidParameters params;
+  params.set_ramps(steps,
+		   fixed_acc_steps(entryRate, acc),
+		   fixed_acc_steps(exitRate, acc),
+		   fixed_acc_steps(nominalRate, acc));
+
+  // Delays in Q.8
+  std::uint64_t c_nominal = fixed_delay(timerFreq, nominalRate);
+  std::uint64_t c0;
+  if (params.n0 == 0) {
+    // 0.676*f*sqrt(2/acc), root of 2*f^2/acc taken in Q.8
+    std::uint64_t square = (std::uint64_t(timerFreq)*timerFreq << 9) / acc;
+    std::uint64_t root = square < (std::uint64_t(1) << 48) ?
+      isqrt(square << 16) : isqrt(square) << 8;
+    if (root < (std::uint64_t(1) << 32)) {
+      c0 = (root*initial_c_factor + (std::uint64_t(1) << 31)) >> 32;
+    }
+    else {
+      // Delays of seconds, drop precision to avoid overflow
+      c0 = ((root >> 8)*initial_c_factor) >> 24;
+    }
+    // Unless nominal speed is reached within the first step
+    if (c0 < c_nominal) {
+      c0 = c_nominal;
+    }
+  }
+  else {
+    c0 = fixed_delay(timerFreq, entryRate);
+  }
+  params.c0 = (c0 + 128) >> 8;
+  params.c0_fraction = static_cast<std::int32_t>(c0 - (params.c0 << 8));
+  params.c_nominal = (c_nominal + 128) >> 8;
+  return params;
+}
+
+void TrapezoidParameters::set_ramps(std::uint32_t steps,
+				    std::uint32_t stepsToEntry,
+				    std::uint32_t stepsToExit,
+				    std::uint32_t stepsToNominal)
+{
   // These are the actual steps we need to [ac,de]celerate
   std::uint32_t accSteps = stepsToNominal - stepsToEntry;
   std::uint32_t decSteps = stepsToNominal - stepsToExit;
@@ -84,15 +221,19 @@ TrapezoidParameters::TrapezoidParameters(std::uint32_t steps,
   this->accelerateUntil = accSteps;
   this->decelerateAfter = accSteps + plateauSteps;
   this->steps = steps;
-  
-  // Setup ramp params
   this->n0 = stepsToEntry;
-  if (stepsToEntry == 0) {
-    // Special case for start from zero speed
-    this->c0 = round(initial_c(timerFreq, acc));
+}
+
+void TrapezoidParameters::carry_fraction(std::int16_t& residue)
+{
+  residue += c0_fraction;
+  if (residue >= 128) {
+    first_adjust = 1;
+    residue -= 256;
   }
-  else {
-    this->c0 = round(timerFreq/entryRate);
+  else if (residue < -128) {
+    first_adjust = -1;
+    residue += 256;
   }
 }
 
@@ -101,6 +242,8 @@ TrapezoidGenerator::TrapezoidGenerator(TrapezoidParameters params)
  , decelerateAfter(params.decelerateAfter)
  , steps(params.steps)
  , step(0)
+ , first_adjust(params.first_adjust)
+ , c_nominal(params.c_nominal)
  , ramp(params.c0, params.n0)
 {
 }
@@ -110,11 +253,12 @@ std::uint32_t TrapezoidGenerator::next_delay() {
     return 0;
   }
 
+  std::uint32_t current = peek_delay();
+  first_adjust = 0;
   step++;
-  std::uint32_t current = ramp.getDelay();
-  
+
   if (step > accelerateUntil && step <= decelerateAfter) {
-    // Cruising
+    // Cruising, the ramp is kept for deceleration
     return current;
   }
   else if (step == decelerateAfter+1) {
@@ -9,6 +9,7 @@
 #define TRAPEZOIDGENERATOR_H
 
 #include <cstdint>
+#include <algorithm>
 
 // Helper class that handles the ramp algorithm
 class Ramp {
@@ -34,11 +35,48 @@ struct TrapezoidParameters {
 		      float timerFreq,
 		      float acc);
 
+  /// Integer only construction from fixed point rates.
+  /** Gives the same result as the float constructor within one timer
+      tick for c0 and one step for the ramp lengths, without any float
+      math or library calls for floor, round or sqrt.
+      @param entryRate, exitRate, nominalRate in steps/s, Q24.8, nominal
+      not zero
+      @param timerFreq in Hz, at most 2^24
+      @param acc in steps/s^2, Q24.8, not zero
+  */
+  static TrapezoidParameters from_fixed(std::uint32_t steps,
+					std::uint32_t entryRate,
+					std::uint32_t exitRate,
+					std::uint32_t nominalRate,
+					std::uint32_t timerFreq,
+					std::uint32_t acc);
+
+  /// Add rounding error of c0 to residue, adjust first delay to compensate.
+  /** With the same residue passed for every move in a sequence, the
+      rounding errors of the first delays do not add up. Only the first
+      delay is adjusted, the ramp and cruise still start from c0.
+      @param residue accumulated error in 1/256 timer ticks
+  */
+  void carry_fraction(std::int16_t& residue);
+
   std::uint32_t steps;
   std::int32_t c0;
+  /// Rounding error of c0 in 1/256 timer ticks, c0 + fraction/256 is exact
+  std::int16_t c0_fraction;
+  /// Added to the first delay only, see carry_fraction()
+  std::int8_t first_adjust;
   std::int32_t n0;
   std::uint32_t accelerateUntil;
   std::uint32_t decelerateAfter;
+  /// Delay at nominal rate, used when cruising, no delay is shorter
+  std::uint32_t c_nominal;
+
+private:
+  /// Set ramp lengths from steps to accelerate from zero to each rate
+  void set_ramps(std::uint32_t steps,
+		 std::uint32_t stepsToEntry,
+		 std::uint32_t stepsToExit,
+		 std::uint32_t stepsToNominal);
 };
 
 /// TrapezoidGenerator produces delays for trapezoid shaped pulse frequency.
@@ -56,6 +94,18 @@ public:
      */
     std::uint32_t next_delay();
 
+    /// Return delay the next call to next_delay() will return.
+    /** Undefined if is_done().
+     */
+    std::uint32_t peek_delay() {
+      std::uint32_t delay = c_nominal;
+      if (step < accelerateUntil || step >= decelerateAfter) {
+	// Short ramps can overshoot the nominal rate
+	delay = std::max(ramp.getDelay(), c_nominal);
+      }
+      return delay + first_adjust;
+    }
+
     /// Returns true when last delay has been calculated by next_delay().
     bool is_done() {
       return steps == step;
@@ -65,6 +115,8 @@ private:
     std::uint32_t decelerateAfter;
     std::uint32_t steps;
     std::uint32_t step;
+    std::int32_t first_adjust;
+    std::uint32_t c_nominal;
     Ramp ramp;
 };
 
@@ -1,85 +1,374 @@
 #include "trapezoid_ticker.h"
-#include "stepper.h"
 #include "planner.h"
 #include <cmath>
+#include <algorithm>
 
-TrapezoidTicker::TrapezoidTicker(const std::vector<Stepper *>& steppers,
-				 Timer* timer)
+const unsigned TrapezoidTicker::max_axes;
+const unsigned TrapezoidTicker::max_level;
+
+TrapezoidTicker::TrapezoidTicker(StepperGroup *steppers, Timer* timer)
   : timer(timer)
   , steppers(steppers)
-  , bresenhams(steppers.size())
+  , move_provider(nullptr)
+  , next_directions(0)
+  , next_ready(false)
+  , delay_residue(0)
+  , pulse_mode(PulseMode::SPLIT)
+  , generator(Generator::RAMP)
   , unstep(false)
+  , held(false)
+  , running(false)
+  , stop_requested(false)
   , step_duration(static_cast<uint32_t>(10e-6f * timer->frequency()))
-{}
+  , pulse_width(static_cast<uint32_t>(2e-6f * timer->frequency()))
+  , max_burst(static_cast<uint32_t>(30e-6f * timer->frequency()))
+  , pending_delay(0)
+  , multi_step_delay(0)
+  , max_interrupt_rate(0)
+  , deadline(0)
+  , requested(0)
+  , lateness_{0, 0, 0}
+{
+}
+
+
+void TrapezoidTicker::set_pulse_mode(PulseMode mode)
+{
+  pulse_mode = mode;
+}
+
+
+void TrapezoidTicker::set_generator(Generator generator)
+{
+  this->generator = generator;
+}
+
+
+void TrapezoidTicker::set_multi_step_rate(float rate)
+{
+  multi_step_delay = rate > 0 ?
+    static_cast<std::uint32_t>(timer->frequency() / rate) : 0;
+}
+
+
+void TrapezoidTicker::set_max_interrupt_rate(float max_interrupt_rate)
+{
+  this->max_interrupt_rate = max_interrupt_rate;
+}
+
+
+void TrapezoidTicker::reset_lateness()
+{
+  lateness_ = Lateness{0, 0, 0};
+}
 
 
 void TrapezoidTicker::start(Planner *move_provider)
 {
   this->move_provider = move_provider;
-  timer->start(this);
+  if (!running) {
+    running = true;
+    stop_requested = false;
+    delay_residue = 0;
+    deadline = timer->timestamp();
+    requested = deadline;
+    timer->start(this);
+  }
+}
+
+void TrapezoidTicker::stop()
+{
+  if (running) {
+    stop_requested = true;
+  }
+}
+
+TrapezoidTicker::Profile TrapezoidTicker::make_profile(const Move& move,
+							float entry_speed,
+							float exit_speed,
+							float frequency,
+							float max_interrupt_rate,
+							PulseMode mode)
+{
+  // Events follow the axis with most steps, so Bresenham always has
+  // dy <= dx and the event rate is the step rate of that axis.
+  int max_steps = 0;
+  int total_steps = 0;
+  for (int steps : move.steps) {
+    max_steps = std::max(max_steps, std::abs(steps));
+    total_steps += std::abs(steps);
+  }
+
+  Profile profile;
+  profile.level = 0;
+  profile.events = max_steps;
+  float events_per_mm = max_steps / move.length;
+  float rate = move.speed * events_per_mm;
+
+  if (max_steps > 0) {
+    // Interrupts per step of the dominant axis: one per event, and in
+    // SPLIT mode one per event with steps, at most one per axis step
+    float stepping = static_cast<float>(total_steps) / max_steps;
+    auto interrupts = [&](unsigned level) {
+      float events = 1u << level;
+      return events + (mode == PulseMode::SPLIT ?
+		       std::min(events, stepping) : 0);
+    };
+    while (profile.level < max_level &&
+	   rate * interrupts(profile.level + 1) <= max_interrupt_rate) {
+      profile.level++;
+    }
+    profile.events <<= profile.level;
+    events_per_mm = profile.events / move.length;
+  }
+
+  profile.entry_rate = entry_speed * events_per_mm;
+  profile.exit_rate = exit_speed * events_per_mm;
+  profile.nominal_rate = move.speed * events_per_mm;
+  profile.acceleration = move.acceleration * events_per_mm;
+  profile.trapezoid = TrapezoidParameters(profile.events,
+					  profile.entry_rate,
+					  profile.exit_rate,
+					  profile.nominal_rate,
+					  frequency,
+					  profile.acceleration);
+  return profile;
 }
 
-void TrapezoidTicker::setup_next_move() {
-  const Move *move = move_provider->get_current_move();
-  if (move) {
-    float rate = 1e3f;
-    float events_per_mm = rate / move->speed;
-    unsigned events = static_cast<unsigned>(events_per_mm * move->length);
+TrapezoidTicker::MoveTrapezoid::MoveTrapezoid(const Profile& profile,
+					       float frequency, bool exact)
+  : exact_(exact)
+{
+  if (exact) {
+    this->exact = ExactTrapezoidGenerator(profile.events,
+					  profile.entry_rate,
+					  profile.exit_rate,
+					  profile.nominal_rate,
+					  frequency,
+					  profile.acceleration);
+  }
+  else {
+    ramp = TrapezoidGenerator(profile.trapezoid);
+  }
+}
+
+bool TrapezoidTicker::prepare_next_move() {
+  while (const Move *move = move_provider->get_current_move()) {
     float entry_speed = std::sqrt(move_provider->get_current_entry_speed_sqr());
     float exit_speed = std::sqrt(move_provider->get_current_exit_speed_sqr());
 
-    for (unsigned ind = 0; ind < steppers.size(); ind++) {
-      steppers[ind]->set_direction(move->steps[ind]>0);
+    Profile profile = make_profile(*move, entry_speed, exit_speed,
+				   timer->frequency(), max_interrupt_rate,
+				   pulse_mode);
+    if (profile.events == 0) {
+      // Nothing to step, a done trapezoid would stop the timer
+      move_provider->next_move();
+      continue;
     }
 
-    TrapezoidParameters params(events,
-			       entry_speed * events_per_mm,
-			       exit_speed * events_per_mm,
-			       rate, /* = speed * events_per_mm */
-			       timer->frequency(),
-			       move->acceleration * events_per_mm);
-    trapezoid = TrapezoidGenerator(params);
+    // Exact delays need no carry, their sum is already rounded
+    profile.trapezoid.carry_fraction(delay_residue);
+    next_trapezoid = MoveTrapezoid(profile, timer->frequency(),
+				   generator == Generator::EXACT);
     
-    for (unsigned ind = 0; ind < steppers.size(); ind++) {
-      bresenhams[ind] = Bresenham(std::abs(move->steps[ind]), events, 1);
+    next_directions = 0;
+    for (unsigned ind = 0; ind < steppers->size(); ind++) {
+      next_directions |= (move->steps[ind]>0) << ind;
+      next_bresenham.set(ind, std::abs(move->steps[ind]), profile.events, 1);
     }
     move_provider->next_move();
+    next_ready = true;
+    break;
+  }
+  return next_ready;
+}
+
+bool TrapezoidTicker::activate_next_move() {
+  if (!next_ready && !prepare_next_move()) {
+    return false;
+  }
+
+  trapezoid = next_trapezoid;
+  bresenham = next_bresenham;
+  steppers->set_directions(next_directions);
+  next_ready = false;
+  return true;
+}
+
+unsigned TrapezoidTicker::events_per_interrupt() {
+  std::uint32_t delay = trapezoid.peek_delay();
+  if (delay >= multi_step_delay) {
+    return 1;
+  }
+  else if (delay >= multi_step_delay/2) {
+    return 2;
+  }
+  else if (delay >= multi_step_delay/4) {
+    return 4;
+  }
+  return 8;
+}
+
+StepperGroup::Mask TrapezoidTicker::tick_bresenham() {
+  return static_cast<StepperGroup::Mask>(bresenham.tick());
+}
+
+void TrapezoidTicker::unstep_all() {
+  steppers->unstep();
+}
+
+void TrapezoidTicker::hold(std::uint32_t since) {
+  std::uint32_t elapsed = timer->timestamp() - since;
+  if (elapsed < pulse_width) {
+    timer->wait(pulse_width - elapsed);
   }
 }
 
 std::uint32_t TrapezoidTicker::on_timer() {
+  std::uint32_t now = timer->timestamp();
+  // Against the requested timestamp, so delays added by the ticker
+  // itself are not counted
+  std::int32_t late = static_cast<std::int32_t>(now - requested);
+  if (late > 0) {
+    lateness_.late++;
+    if (static_cast<std::uint32_t>(late) > lateness_.max) {
+      lateness_.max = late;
+    }
+  }
+
+  std::uint32_t delay = tick();
+  if (delay == 0) {
+    return 0;
+  }
+
+  // Keep full pulse high and low times, also after busy waits in tick()
+  std::int32_t min_delay = timer->timestamp() - now + step_duration;
+
+  deadline += delay;
+  std::int32_t remaining = static_cast<std::int32_t>(deadline - now);
+  if (remaining <= 0 && late > 0) {
+    // Already due, run as soon as possible and catch up
+    lateness_.missed++;
+  }
+  if (remaining < min_delay) {
+    remaining = min_delay;
+  }
+  requested = now + remaining;
+  return remaining;
+}
+
+std::uint32_t TrapezoidTicker::tick() {
   std::uint32_t next_delay = 0; // This means: stop timer
   
-  if (unstep) {
+  if (stop_requested) {
+    stop_requested = false;
+    unstep_all();
     unstep = false;
+    held = false;
+    pending_delay = 0;
+    trapezoid = MoveTrapezoid();
+    next_ready = false;
+  }
+  else if (unstep) {
+    unstep = false;
+    unstep_all();
 
-    for (unsigned stepper = 0; stepper < steppers.size(); ++stepper) {
-      steppers[stepper]->unstep();
-    }
-    next_delay = trapezoid.next_delay() - step_duration;
+    std::uint32_t delay = pending_delay + trapezoid.next_delay();
+    pending_delay = 0;
+    next_delay = delay > step_duration ? delay - step_duration : 1;
 
     if (trapezoid.is_done()) {
-      // Try to setup next move now
-      setup_next_move();
+      activate_next_move();
     }
   }
   else {
-    // If just started, we need to start by setting up trapezoid.
-    if (trapezoid.is_done()) {
-      setup_next_move();
-      // Todo: Reset timer to avoid getting next step too quickly
+    // Pins released here need their low time before the next step,
+    // the work until then counts towards it
+    bool released = held;
+    std::uint32_t release_time = 0;
+    if (held) {
+      unstep_all();
+      held = false;
+      release_time = timer->timestamp();
+      // Ramp of the held event, left for the low time
+      trapezoid.next_delay();
     }
 
-    if (!trapezoid.is_done()) {
-      for (unsigned stepper = 0; stepper < steppers.size(); ++stepper) {
-	if (bresenhams[stepper].tick()) {
-	  steppers[stepper]->step();
+    // When just started, or if the next move was not available at the
+    // end of the previous one. Directions change only while step pins
+    // are low, and the move starts after the direction setup time.
+    if (trapezoid.is_done() && activate_next_move() && !released) {
+      next_delay = step_duration;
+    }
+    else if (!trapezoid.is_done()) {
+      unsigned events = events_per_interrupt();
+      StepperGroup::Mask mask = tick_bresenham();
+      if (released) {
+	// Low time in MERGED mode, the group keeps direction setup
+	hold(release_time);
+      }
+      steppers->step(mask);
+      // Oversampled events often step nothing and need no unstep
+      bool high = mask != 0;
+
+      // Ramp and Bresenham work of each event counts towards the
+      // pulse times, and the events stop after max_burst
+      std::uint32_t first_step = timer->timestamp();
+      for (unsigned event = 1; event < events; ++event) {
+	std::uint32_t step_time = timer->timestamp();
+	if (step_time - first_step + 2*pulse_width > max_burst) {
+	  // Remaining events from the next interrupt
+	  break;
 	}
+	pending_delay += trapezoid.next_delay();
+	hold(step_time);
+	unstep_all();
+	high = false;
+	if (trapezoid.is_done()) {
+	  // Last delay consumed, added below
+	  break;
+	}
+	std::uint32_t release_time = timer->timestamp();
+	mask = tick_bresenham();
+	hold(release_time);
+	steppers->step(mask);
+	high = mask != 0;
+      }
+
+      std::uint32_t delay = pending_delay;
+      if (!trapezoid.is_done()) {
+	delay += trapezoid.peek_delay();
+      }
+
+      if (!high) {
+	// No pins to release, straight on to the next event
+	trapezoid.next_delay();
+	pending_delay = 0;
+	next_delay = delay;
+	if (trapezoid.is_done()) {
+	  activate_next_move();
+	}
+      }
+      else if (pulse_mode == PulseMode::MERGED && delay >= 2*pulse_width) {
+	// Keep pins until next event, which also advances the ramp and
+	// activates the next move if this one is done
+	pending_delay = 0;
+	next_delay = delay;
+	held = true;
+      }
+      else {
+	unstep = true;
+	next_delay = step_duration;
       }
-      unstep = true;
-      next_delay = step_duration;
     }
   }
 
+  if (next_delay == 0) {
+    running = false;
+  }
+  else if (!next_ready) {
+    // Pulses of this interrupt are already out
+    prepare_next_move();
+  }
   return next_delay;
 }
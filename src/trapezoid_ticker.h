@@ -1,23 +1,46 @@
 #ifndef TRAPEZOID_TICKER_H
 #define TRAPEZOID_TICKER_H
 
-#include <vector>
 #include "timer.h"
-#include "bresenham.h"
+#include "multi_bresenham.h"
+#include "stepper_group.h"
 #include "trapezoid_generator.h"
+#include "exact_trapezoid_generator.h"
 
-class Stepper;
 class Planner;
+struct Move;
 
 /// Generate steps following trapezoid profile.
 /**
    This class uses a Timer to generate a time base with a trapezoid shaped
    frequency, and uses this to generate step pulses to stepper motors. The
    trapzeoid and step pulses are supplied by a MoveProvider.
+
+   The steppers are a StepperGroup, so the step mask of MultiBresenham
+   is written with one mask write per port.
  */
 class TrapezoidTicker : public TimerCallback {
  public:
-  TrapezoidTicker(const std::vector<Stepper*>& steppers, Timer *timer);
+  /// Highest number of steppers
+  static const unsigned max_axes = StepperGroup::max_axes;
+
+  TrapezoidTicker(StepperGroup *steppers, Timer *timer);
+
+  /// How step pulses are ended
+  enum class PulseMode {
+    SPLIT,  ///< Separate interrupt to unstep after step duration
+    MERGED, ///< Unstep at start of next event when possible
+  };
+
+  /// Select pulse mode, default is SPLIT.
+  /** In MERGED mode there is one interrupt per event. Step pins are
+      held until the next event, and a separate unstep interrupt is
+      only used when the next event is closer than twice the pulse
+      width. The next event releases the pins first and steps last,
+      so its ramp, Bresenham and move work counts towards the pulse
+      low time, and only the rest of the pulse width is busy waited.
+  */
+  void set_pulse_mode(PulseMode mode);
 
   /// Start generating steps until no more moves are available.
   /** Moves are repeatedly pulled from the move_provider.
@@ -25,16 +48,201 @@ class TrapezoidTicker : public TimerCallback {
   */
   void start(Planner *move_provider);
 
+  /// Abort current move as soon as possible.
+  /** Step pins are released and the current and prepared moves are
+      dropped in the next interrupt, after which is_running() returns
+      false. Moves left in the planner are not touched.
+  */
+  void stop();
+
+  /// Delay generator used for moves
+  enum class Generator {
+    RAMP,  ///< TrapezoidGenerator, recurrence with one division per event
+    EXACT, ///< ExactTrapezoidGenerator, exact event times
+  };
+
+  /// Select generator, default is RAMP.
+  /** Takes effect from the next move that is prepared.
+   */
+  void set_generator(Generator generator);
+
+  /// Emit several step events per interrupt at high event rates.
+  /** Above rate events per second, 2 events are emitted per interrupt,
+      above 2*rate 4 events, and above 4*rate 8 events. Events within
+      an interrupt are emitted two pulse widths apart, or as far apart
+      as their ramp and Bresenham work takes, so they may move by up
+      to that much per event. The time of the first event of each
+      interrupt, and thus the total move time, is unaffected.
+
+      No more events are started once an interrupt has been stepping
+      for max_burst, the rest follow from the next interrupt. This
+      bounds how long other interrupts wait, at the cost of an extra
+      interrupt when the per event work is slow: on the target the
+      ramp division alone is about 40 us, so mostly 2 events fit.
+      @param rate threshold in events per second, 0 disables.
+  */
+  void set_multi_step_rate(float rate);
+
+  /// Oversample the DDA at low event rates for smoother slow axes.
+  /** See make_profile().
+      @param max_interrupt_rate budget in interrupts per second, 0
+      disables.
+  */
+  void set_max_interrupt_rate(float max_interrupt_rate);
+
+  /// Returns true from start() until no more moves are available
+  bool is_running() const {
+    return running;
+  }
+
+  /// Interrupt timing relative to the timestamps requested from Timer
+  /** Only delays outside the ticker count, like interrupt latency and
+      other interrupts. Pulse widths, busy waits and events moved by
+      multi stepping are part of the requested timestamps.
+   */
+  struct Lateness {
+    /// Interrupts that ran after their timestamp
+    unsigned late;
+    /// Late interrupts that ran after the event time of the next one
+    unsigned missed;
+    /// Highest lateness in timer ticks
+    std::uint32_t max;
+  };
+
+  const Lateness& lateness() const {
+    return lateness_;
+  }
+
+  void reset_lateness();
+
+  /// Trapezoid and number of DDA events used to execute a move
+  struct Profile {
+    TrapezoidParameters trapezoid;
+    unsigned events;
+    /// Oversampling level, events are multiplied by 2^level
+    unsigned level;
+    /// Rates in events/s and acceleration in events/s^2 of trapezoid
+    float entry_rate;
+    float exit_rate;
+    float nominal_rate;
+    float acceleration;
+  };
+
+  /// Highest oversampling level used by make_profile()
+  static const unsigned max_level = 3;
+
+  /// Calculate profile for move.
+  /** There is one DDA event per step of the axis with most steps, and
+      the trapezoid rates are in steps per second of that axis.
+      Moves without steps get zero events.
+
+      Adaptive multi-axis step smoothing: Bresenham can only place steps
+      of slower axes on event boundaries, so their step spacing
+      alternates between neighbouring event counts. At low step rates
+      the event rate is doubled, up to max_level times, as long as the
+      interrupt rate at nominal speed stays within max_interrupt_rate.
+      This reduces the spacing error of all axes by the same factor.
+      Every event takes one interrupt, and in SPLIT mode an event that
+      steps any axis takes a second one to unstep. Events without
+      steps are not unstepped.
+      @param entry_speed, exit_speed in mm/s
+      @param frequency timer frequency in Hz
+      @param max_interrupt_rate budget in interrupts per second, 0
+      disables oversampling.
+      @param mode pulse mode the move is executed with
+  */
+  static Profile make_profile(const Move& move,
+			      float entry_speed,
+			      float exit_speed,
+			      float frequency,
+			      float max_interrupt_rate = 0,
+			      PulseMode mode = PulseMode::SPLIT);
+
  private:
-  void setup_next_move();
+  /// Delays of one move from the selected generator
+  class MoveTrapezoid {
+   public:
+    MoveTrapezoid() : exact_(false) {}
+    MoveTrapezoid(const Profile& profile, float frequency, bool exact);
+
+    std::uint32_t next_delay() {
+      return exact_ ? exact.next_delay() : ramp.next_delay();
+    }
+
+    std::uint32_t peek_delay() {
+      return exact_ ? exact.peek_delay() : ramp.peek_delay();
+    }
+
+    bool is_done() {
+      return exact_ ? exact.is_done() : ramp.is_done();
+    }
+
+   private:
+    bool exact_;
+    TrapezoidGenerator ramp;
+    ExactTrapezoidGenerator exact;
+  };
+
+  /// Calculate profile for next move ahead of time, if available
+  bool prepare_next_move();
+  /// Switch to prepared move, preparing it first if needed
+  bool activate_next_move();
   std::uint32_t on_timer();
+
+  /// Run current event, returns delay to the next or 0 when done
+  std::uint32_t tick();
+
+  /// Number of events to emit in this interrupt
+  unsigned events_per_interrupt();
+
+  /// Tick Bresenham for one event, returns axes to step
+  StepperGroup::Mask tick_bresenham();
+  void unstep_all();
+  /// Busy wait until pulse_width after since
+  void hold(std::uint32_t since);
   Timer *timer;
-  std::vector<Stepper*> steppers;
-  std::vector<Bresenham> bresenhams;
+  StepperGroup *steppers;
+  MultiBresenham<max_axes> bresenham;
   Planner *move_provider;
-  TrapezoidGenerator trapezoid;
+  MoveTrapezoid trapezoid;
+
+  /// Move prepared while the current one is executing
+  MoveTrapezoid next_trapezoid;
+  MultiBresenham<max_axes> next_bresenham;
+  StepperGroup::Mask next_directions;
+  bool next_ready;
+  /// Rounding error of first delays carried between moves
+  std::int16_t delay_residue;
+
+  PulseMode pulse_mode;
+  Generator generator;
   bool unstep;
+  /// Step pins are held until the next event, MERGED mode
+  bool held;
+  volatile bool running;
+  volatile bool stop_requested;
+  /// Step high time with a separate unstep interrupt
   std::uint32_t step_duration;
+  /// Step high and low time where the ticker busy waits, 2 us. The
+  /// A4982 drivers of the Melzi need 1 us, DRV8825 drivers 1.9 us.
+  std::uint32_t pulse_width;
+  /// Longest time from first to last step of one interrupt, 30 us.
+  /// A byte takes 40 us at 250 kbaud, so the UART receive interrupt
+  /// is not held off past its buffer.
+  std::uint32_t max_burst;
+
+  /// Delays of events already emitted in this interrupt
+  std::uint32_t pending_delay;
+  /// Event delay below which multi stepping starts, 0 if disabled
+  std::uint32_t multi_step_delay;
+  /// Interrupt rate budget for oversampling, 0 if disabled
+  float max_interrupt_rate;
+
+  /// Event time of the current interrupt
+  std::uint32_t deadline;
+  /// Timestamp requested for the current interrupt, deadline or later
+  std::uint32_t requested;
+  Lateness lateness_;
 };
 
 #endif
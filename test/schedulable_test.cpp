@@ -1,5 +1,7 @@
 #include "src/scheduling_timer.h"
 
+#include <cstdlib>
+#include <vector>
 #include <gmock/gmock.h>
 
 struct MockSchedulable : public Schedulable
@@ -137,3 +139,170 @@ TEST(SchedulableTest, double) {
   EXPECT_CALL(s.get_base(), stop_timer());
   s.on_timer();
 }
+
+TEST(SchedulableTest, remove_last) {
+  MockSchedulable task;
+  SchedulingTimer<MockBase> s;
+
+  ::testing::InSequence dummy;
+  EXPECT_CALL(s.get_base(), disable_interrupts());
+  EXPECT_CALL(s.get_base(), start_timer(10));
+  EXPECT_CALL(s.get_base(), enable_interrupts());
+  s.schedule(&task, 10);
+
+  EXPECT_CALL(s.get_base(), disable_interrupts());
+  EXPECT_CALL(s.get_base(), stop_timer());
+  EXPECT_CALL(s.get_base(), enable_interrupts());
+  s.remove(&task);
+
+  EXPECT_CALL(s.get_base(), stop_timer());
+  s.on_timer();
+}
+
+TEST(SchedulableTest, heap_double) {
+  MockSchedulable task1, task2;
+  SchedulingTimer<MockBase, HeapQueue<4> > s;
+
+  ::testing::InSequence dummy;
+  EXPECT_CALL(s.get_base(), disable_interrupts());
+  EXPECT_CALL(s.get_base(), start_timer(20));
+  EXPECT_CALL(s.get_base(), enable_interrupts());
+  s.schedule(&task2, 20);
+
+  EXPECT_CALL(s.get_base(), disable_interrupts());
+  EXPECT_CALL(s.get_base(), start_timer(10));
+  EXPECT_CALL(s.get_base(), enable_interrupts());
+  s.schedule(&task1, 10);
+
+  EXPECT_CALL(s.get_base(), current_timestamp()).WillOnce(Return(10));
+  EXPECT_CALL(task1, on_timer());
+  EXPECT_CALL(s.get_base(), current_timestamp()).WillOnce(Return(10));
+  EXPECT_CALL(s.get_base(), start_timer(20));
+  s.on_timer();
+
+  EXPECT_CALL(s.get_base(), current_timestamp()).WillOnce(Return(20));
+  EXPECT_CALL(task2, on_timer());
+  EXPECT_CALL(s.get_base(), stop_timer());
+  s.on_timer();
+}
+
+namespace {
+  /// Timer base with a settable clock
+  struct ClockBase {
+    ClockBase() : now(0), next(0), running(false) {}
+    void set_callback(TimerCallback *) {}
+    uint32_t frequency() const { return 1000000; }
+    void disable_interrupts() {}
+    void enable_interrupts() {}
+    void start_timer(uint16_t timestamp) { next = timestamp; running = true; }
+    void stop_timer() { running = false; }
+    uint16_t current_timestamp() { return now; }
+
+    uint16_t now;
+    uint16_t next;
+    bool running;
+  };
+
+  struct RecordingTask : public Schedulable {
+    void on_timer() {
+      order->push_back(id);
+    }
+    using Schedulable::get_timestamp;
+
+    int id;
+    std::vector<int> *order;
+  };
+
+  /// Schedule tasks on random timestamps, remove some and run all
+  template <class Queue>
+  void check_order(uint16_t start) {
+    const int count = 50;
+    SchedulingTimer<ClockBase, Queue> s;
+    s.get_base().now = start;
+    RecordingTask tasks[count];
+    std::vector<int> order;
+
+    std::srand(3);
+    for (int id = 0; id < count; id++) {
+      tasks[id].id = id;
+      tasks[id].order = &order;
+      ASSERT_TRUE(s.schedule(&tasks[id], start + 1 + std::rand() % 10000));
+    }
+    for (int id = 0; id < count; id += 7) {
+      s.remove(&tasks[id]);
+    }
+
+    while (s.get_base().running) {
+      s.get_base().now = s.get_base().next;
+      s.on_timer();
+    }
+
+    ASSERT_EQ(count - (count + 6)/7, int(order.size()));
+    for (unsigned ind = 0; ind < order.size(); ind++) {
+      EXPECT_NE(0, order[ind] % 7);
+      if (ind > 0) {
+	EXPECT_FALSE(static_cast<int16_t>(tasks[order[ind]].get_timestamp() -
+					  tasks[order[ind - 1]].get_timestamp())
+		     < 0);
+      }
+    }
+  }
+}
+
+TEST(SchedulableTest, list_reschedule) {
+  SchedulingTimer<ClockBase> s;
+  RecordingTask tasks[2];
+  std::vector<int> order;
+  for (int id = 0; id < 2; id++) {
+    tasks[id].id = id;
+    tasks[id].order = &order;
+  }
+
+  s.schedule(&tasks[0], 10);
+  s.schedule(&tasks[1], 20);
+  s.schedule(&tasks[0], 30);
+  EXPECT_EQ(20, s.get_base().next);
+
+  s.get_base().now = 30;
+  s.on_timer();
+  EXPECT_EQ((std::vector<int>{1, 0}), order);
+}
+
+TEST(SchedulableTest, list_order) {
+  check_order<ListQueue>(0);
+  check_order<ListQueue>(60000);
+}
+
+TEST(SchedulableTest, heap_order) {
+  check_order<HeapQueue<50> >(0);
+  check_order<HeapQueue<50> >(60000);
+}
+
+TEST(SchedulableTest, heap_full) {
+  SchedulingTimer<ClockBase, HeapQueue<2> > s;
+  RecordingTask tasks[3];
+  std::vector<int> order;
+  for (int id = 0; id < 3; id++) {
+    tasks[id].id = id;
+    tasks[id].order = &order;
+  }
+
+  EXPECT_TRUE(s.schedule(&tasks[0], 30));
+  EXPECT_TRUE(s.schedule(&tasks[1], 20));
+  EXPECT_FALSE(s.schedule(&tasks[2], 10));
+  EXPECT_EQ(20, s.get_base().next);
+
+  // Rescheduling a queued task moves it
+  EXPECT_TRUE(s.schedule(&tasks[0], 5));
+  EXPECT_EQ(5, s.get_base().next);
+
+  s.remove(&tasks[0]);
+  EXPECT_EQ(20, s.get_base().next);
+  EXPECT_TRUE(s.schedule(&tasks[2], 10));
+  EXPECT_EQ(10, s.get_base().next);
+
+  s.get_base().now = 25;
+  s.on_timer();
+  EXPECT_EQ((std::vector<int>{2, 1}), order);
+  EXPECT_FALSE(s.get_base().running);
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <src/bed_mesh.h>
+
+namespace {
+  // 3x3 mesh from (-10,-10) to (10,10)
+  BedMesh make_mesh() {
+    BedMesh mesh(-10, -10, 10, 3, 3);
+    for (unsigned iy = 0; iy < 3; iy++) {
+      for (unsigned ix = 0; ix < 3; ix++) {
+	mesh.set_offset(ix, iy, 0.1f*ix + 0.01f*iy);
+      }
+    }
+    mesh.set_offset(1, 1, 1);
+    return mesh;
+  }
+}
+
+TEST(BedMesh, Flat) {
+  BedMesh mesh(0, 0, 10, 2, 2);
+  EXPECT_FLOAT_EQ(0, mesh.offset(5, 5));
+}
+
+TEST(BedMesh, GridPoints) {
+  BedMesh mesh = make_mesh();
+  for (unsigned iy = 0; iy < 3; iy++) {
+    for (unsigned ix = 0; ix < 3; ix++) {
+      float x = -10 + 10.0f*ix;
+      float y = -10 + 10.0f*iy;
+      EXPECT_FLOAT_EQ(mesh.get_offset(ix, iy), mesh.offset(x, y))
+	<< ix << ", " << iy;
+    }
+  }
+}
+
+TEST(BedMesh, Bilinear) {
+  BedMesh mesh = make_mesh();
+
+  // Center of cell (0,0)
+  float expected = (mesh.get_offset(0, 0) + mesh.get_offset(1, 0) +
+		    mesh.get_offset(0, 1) + mesh.get_offset(1, 1))/4;
+  EXPECT_FLOAT_EQ(expected, mesh.offset(-5, -5));
+
+  // Along edge between two points
+  expected = 0.75f*mesh.get_offset(1, 2) + 0.25f*mesh.get_offset(2, 2);
+  EXPECT_FLOAT_EQ(expected, mesh.offset(2.5f, 10));
+}
+
+TEST(BedMesh, ClampOutside) {
+  BedMesh mesh = make_mesh();
+  EXPECT_FLOAT_EQ(mesh.get_offset(0, 0), mesh.offset(-20, -30));
+  EXPECT_FLOAT_EQ(mesh.get_offset(2, 2), mesh.offset(20, 30));
+  EXPECT_FLOAT_EQ(mesh.get_offset(2, 0), mesh.offset(15, -15));
+}
+
+TEST(BedMesh, CacheInvalidatedBySetOffset) {
+  BedMesh mesh = make_mesh();
+  EXPECT_FLOAT_EQ(mesh.get_offset(0, 0), mesh.offset(-10, -10));
+  mesh.set_offset(0, 0, 2);
+  EXPECT_FLOAT_EQ(2, mesh.offset(-10, -10));
+}
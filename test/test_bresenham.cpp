@@ -1,4 +1,6 @@
 #include <src/bresenham.h>
+#include <src/multi_bresenham.h>
+#include <cstdlib>
 #include <gtest/gtest.h>
 
 TEST(Bresenham, 5_10_slope) {
@@ -29,3 +31,49 @@ TEST(Bresenham, zero_slope) {
   EXPECT_FALSE(b.tick());
   EXPECT_FALSE(b.tick());
 }
+
+TEST(MultiBresenham, step_mask) {
+  MultiBresenham<3> b;
+  b.set(0, 5, 10);
+  b.set(1, 2, 5);
+  b.set(2, 5, 5);
+
+  EXPECT_EQ(7u, b.tick());
+  EXPECT_EQ(4u, b.tick());
+  EXPECT_EQ(7u, b.tick());
+  EXPECT_EQ(4u, b.tick());
+  EXPECT_EQ(5u, b.tick());
+}
+
+TEST(MultiBresenham, unused_axes_do_not_step) {
+  MultiBresenham<8> b;
+  b.set(1, 3, 3);
+
+  for (int i=0; i < 3; i++) {
+    EXPECT_EQ(2u, b.tick());
+  }
+}
+
+TEST(MultiBresenham, same_as_bresenham) {
+  const unsigned axes = 5;
+  std::srand(1);
+  for (int run=0; run < 100; run++) {
+    int dx = 1 + std::rand() % 1000;
+    int offset = std::rand() % 3;
+    MultiBresenham<axes> multi;
+    Bresenham single[axes];
+    for (unsigned axis=0; axis < axes; axis++) {
+      int dy = std::rand() % (dx + 1);
+      multi.set(axis, dy, dx, offset);
+      single[axis] = Bresenham(dy, dx, offset);
+    }
+
+    for (int i=0; i < dx; i++) {
+      MultiBresenham<axes>::Mask expected = 0;
+      for (unsigned axis=0; axis < axes; axis++) {
+	expected |= single[axis].tick() << axis;
+      }
+      ASSERT_EQ(expected, multi.tick());
+    }
+  }
+}
@@ -1,5 +1,6 @@
 #include "src/delta_gantry.h"
 #include "src/planner.h"
+#include "src/bed_mesh.h"
 
 #include <gtest/gtest.h>
 #include <iostream>
@@ -49,3 +50,108 @@ TEST(DeltaGantry, Init)
     print_move(move);
   }
 }
+
+TEST(DeltaGantry, BedMesh)
+{
+  std::vector<DeltaGantry::Axis> axes(3, DeltaGantry::Axis{100, 1e-4, 1e-6});
+  std::vector<DeltaGantry::Tower> towers;
+  towers.push_back(DeltaGantry::Tower{{5,0,0},10});
+  towers.push_back(DeltaGantry::Tower{{0,5,0},10});
+  towers.push_back(DeltaGantry::Tower{{-5,0,0},10});
+
+  BedMesh mesh(-10, -10, 20, 2, 2);
+  for (unsigned ix = 0; ix < 2; ix++) {
+    for (unsigned iy = 0; iy < 2; iy++) {
+      mesh.set_offset(ix, iy, .5f);
+    }
+  }
+
+  DeltaGantry gantry(axes, towers);
+  DeltaGantry::LinearMove move;
+  move.steps.resize(axes.size());
+  gantry.set_speed(30);
+
+  // Pure z move, no compensation
+  gantry.set_cartesian(2, .05f);
+  ASSERT_TRUE(gantry.get_move(move));
+  for (unsigned axis = 0; axis < axes.size(); ++axis) {
+    EXPECT_EQ(5, move.steps[axis]);
+  }
+  EXPECT_FALSE(gantry.get_move(move));
+
+  // Constant offset is added to z move
+  gantry.set_bed_mesh(&mesh);
+  gantry.set_cartesian(2, .1f);
+  ASSERT_TRUE(gantry.get_move(move));
+  for (unsigned axis = 0; axis < axes.size(); ++axis) {
+    EXPECT_NEAR(55, move.steps[axis], 1);
+  }
+  EXPECT_FALSE(gantry.get_move(move));
+}
+
+namespace {
+  DeltaGantry make_realistic_delta() {
+    std::vector<DeltaGantry::Axis> axes(4, DeltaGantry::Axis{80, 1e-5, 1e-6});
+    std::vector<DeltaGantry::Tower> towers;
+    const float radius = 100;
+    const float pi = 3.14159265f;
+    for (unsigned tower = 0; tower < 3; ++tower) {
+      float angle = pi/2 + tower*2*pi/3;
+      towers.push_back(DeltaGantry::Tower{
+	  {radius*cosf(angle), radius*sinf(angle), -10}, 215});
+    }
+    return DeltaGantry(axes, towers);
+  }
+}
+
+TEST(DeltaGantry, ForwardKinematics)
+{
+  DeltaGantry gantry = make_realistic_delta();
+
+  float cartesian[3];
+  std::vector<int> steps{20000, 20000, 20000, 0};
+  ASSERT_TRUE(gantry.get_cartesian_from_steps(steps, cartesian));
+  EXPECT_NEAR(0, cartesian[0], 1e-3);
+  EXPECT_NEAR(0, cartesian[1], 1e-3);
+
+  // Carriages at 250 mm above origin, arms reach down sqrt(215^2-100^2)
+  EXPECT_NEAR(-10 + 250 - sqrtf(215*215 - 100*100), cartesian[2], 1e-3);
+
+  // Unreachable, carriage 0 too far above the others
+  steps[0] = 60000;
+  EXPECT_FALSE(gantry.get_cartesian_from_steps(steps, cartesian));
+}
+
+TEST(DeltaGantry, ResyncFromSteps)
+{
+  DeltaGantry gantry = make_realistic_delta();
+  std::vector<int> steps{20000, 20000, 20000, 400};
+  ASSERT_TRUE(gantry.set_position_from_steps(steps));
+  EXPECT_NEAR(0, gantry.get_cartesian(0), 1e-3);
+  EXPECT_NEAR(0, gantry.get_cartesian(1), 1e-3);
+
+  // No pending move after resync
+  DeltaGantry::LinearMove move;
+  move.steps.resize(steps.size());
+  EXPECT_FALSE(gantry.get_move(move));
+
+  // Move and track stepper positions from move steps
+  const float target[3] = {10, -5, gantry.get_cartesian(2) - 3};
+  gantry.set_speed(50);
+  for (unsigned coord = 0; coord < 3; coord++) {
+    gantry.set_cartesian(coord, target[coord]);
+  }
+  gantry.set_extruder(0, 7);
+  while (gantry.get_move(move)) {
+    for (unsigned axis = 0; axis < steps.size(); ++axis) {
+      steps[axis] += move.steps[axis];
+    }
+  }
+
+  // Recovered position is within step resolution of target
+  ASSERT_TRUE(gantry.set_position_from_steps(steps));
+  for (unsigned coord = 0; coord < 3; coord++) {
+    EXPECT_NEAR(target[coord], gantry.get_cartesian(coord), 0.05) << coord;
+  }
+  EXPECT_EQ(560, steps[3]);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include <src/flow_control.h>
+#include <src/ring_buffer.h>
+
+namespace {
+  std::string take(flow_control::Device& device, bool idle = false) {
+    uint8_t message[flow_control::max_message];
+    uint8_t length = device.take_message(message, idle);
+    return std::string(message, message + length);
+  }
+}
+
+TEST(FlowControl, DeviceReportsAboveThreshold) {
+  flow_control::Device device(10);
+
+  EXPECT_EQ("", take(device));
+  device.consumed(9);
+  EXPECT_EQ("", take(device));
+  device.consumed();
+  EXPECT_EQ("\x11" "10\n", take(device));
+  EXPECT_EQ("", take(device));
+
+  device.consumed(3);
+  EXPECT_EQ("\x11" "3\n", take(device, true));
+
+  device.consumed(200);
+  device.consumed(100);
+  EXPECT_EQ("\x11" "255\n", take(device));
+  EXPECT_EQ("\x11" "45\n", take(device));
+}
+
+TEST(FlowControl, HostParsesCredit) {
+  flow_control::Host host(100);
+
+  EXPECT_EQ(100, host.available());
+  host.sent(80);
+  EXPECT_EQ(20, host.available());
+
+  // Lines starting with c are output, credit may interrupt a line
+  std::string reply = "ok\n\x11" "30\ncount 3\nab\x11" "5\nc\n";
+  std::string passed;
+  for (char c : reply) {
+    if (!host.receive(c)) {
+      passed += c;
+    }
+  }
+  EXPECT_EQ("ok\ncount 3\nabc\n", passed);
+  EXPECT_EQ(45, host.bytes_in_flight());
+}
+
+TEST(FlowControl, WindowPreventsOverrun) {
+  // Host streams into a device which consumes slower than the link
+  typedef RingBuffer<32> RxBuffer;
+  RxBuffer rx;
+  flow_control::Device device(RxBuffer::capacity()/4);
+  flow_control::Host host(RxBuffer::capacity());
+  std::string reply;
+
+  unsigned remaining = 1000;
+  unsigned overruns = 0;
+  unsigned received = 0;
+  unsigned tick = 0;
+  while (received < 1000) {
+    // Link, at most 4 bytes per tick in each direction
+    for (unsigned ind = 0; ind < 4 && remaining > 0 && host.available(); ind++) {
+      host.sent(1);
+      remaining--;
+      overruns += !rx.push('x');
+    }
+    for (unsigned ind = 0; ind < 4 && !reply.empty(); ind++) {
+      host.receive(reply[0]);
+      reply.erase(0, 1);
+    }
+
+    // Device main loop, one byte every third tick
+    uint8_t byte;
+    if (++tick % 3 == 0 && rx.pop(byte)) {
+      device.consumed();
+      received++;
+    }
+    uint8_t message[flow_control::max_message];
+    uint8_t length = device.take_message(message, rx.is_empty());
+    reply.append(message, message + length);
+  }
+
+  EXPECT_EQ(0u, overruns);
+  EXPECT_EQ(0u, remaining);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <src/gantry_feeder.h>
+#include <src/delta_gantry.h>
+#include <src/planner.h>
+
+namespace {
+  DeltaGantry make_delta() {
+    std::vector<DeltaGantry::Axis> axes(4, DeltaGantry::Axis{100, 1e-4, 1e-6});
+    std::vector<DeltaGantry::Tower> towers;
+    towers.push_back(DeltaGantry::Tower{{5,0,0},10});
+    towers.push_back(DeltaGantry::Tower{{0,5,0},10});
+    towers.push_back(DeltaGantry::Tower{{-5,0,0},10});
+    return DeltaGantry(axes, towers);
+  }
+}
+
+TEST(GantryFeeder, GetMovesMatchesGetMove) {
+  DeltaGantry single = make_delta();
+  DeltaGantry batched = make_delta();
+  single.set_speed(30);
+  single.set_cartesian(0, 1);
+  batched.set_speed(30);
+  batched.set_cartesian(0, 1);
+
+  std::vector<Gantry::LinearMove> moves(4);
+  for (auto& move : moves) {
+    move.steps.resize(4);
+  }
+  Gantry::LinearMove move;
+  move.steps.resize(4);
+
+  unsigned total = 0;
+  unsigned count;
+  while ((count = batched.get_moves(&moves[0], moves.size())) > 0) {
+    for (unsigned ind = 0; ind < count; ++ind) {
+      ASSERT_TRUE(single.get_move(move));
+      EXPECT_EQ(move.steps, moves[ind].steps);
+      EXPECT_FLOAT_EQ(move.length, moves[ind].length);
+    }
+    total += count;
+  }
+  EXPECT_FALSE(single.get_move(move));
+  EXPECT_EQ(10u, total);
+}
+
+TEST(GantryFeeder, FillsPlanner) {
+  DeltaGantry gantry = make_delta();
+  Planner planner(8, 4);
+  GantryFeeder feeder(&gantry, &planner, 4, 4);
+
+  gantry.set_speed(30);
+  gantry.set_cartesian(0, 1);
+
+  // Limited by batch size, then by free slots
+  EXPECT_EQ(4u, feeder.feed());
+  EXPECT_EQ(3u, feeder.feed());
+  EXPECT_TRUE(planner.is_buffer_full());
+  EXPECT_EQ(0u, feeder.feed());
+
+  // Drain planner and transfer remaining moves
+  unsigned planned = 0;
+  unsigned count;
+  do {
+    while (planner.get_current_move()) {
+      planner.next_move();
+      planned++;
+    }
+    count = feeder.feed();
+  } while (count > 0 || planner.get_current_move());
+
+  EXPECT_EQ(10u, planned);
+}
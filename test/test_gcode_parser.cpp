@@ -0,0 +1,162 @@
+#include <gmock/gmock.h>
+#include <cstring>
+
+#include <src/gcode_parser.h>
+#include <src/ring_buffer.h>
+#include <src/gantry.h>
+
+namespace {
+  struct MockGantry : public Gantry {
+    MOCK_METHOD2(set_cartesian, void(unsigned, float));
+    MOCK_METHOD2(set_extruder, void(unsigned, float));
+    MOCK_METHOD1(set_speed, void(float));
+    MOCK_METHOD1(get_move, bool(LinearMove&));
+  };
+
+  template <unsigned Size>
+  void push(RingBuffer<Size>& rx, const char *text) {
+    for (const char *c = text; *c; c++) {
+      ASSERT_TRUE(rx.push(*c));
+    }
+  }
+}
+
+using ::testing::FloatEq;
+using ::testing::_;
+
+TEST(RingBuffer, PushPop) {
+  RingBuffer<4> rx;
+  uint8_t byte;
+
+  EXPECT_TRUE(rx.is_empty());
+  EXPECT_EQ(3, rx.capacity());
+  EXPECT_FALSE(rx.pop(byte));
+
+  // Wrap around a few times
+  for (uint8_t round = 0; round < 3; round++) {
+    EXPECT_TRUE(rx.push(1));
+    EXPECT_TRUE(rx.push(2));
+    EXPECT_TRUE(rx.push(3));
+    EXPECT_TRUE(rx.is_full());
+    EXPECT_FALSE(rx.push(4));
+    EXPECT_EQ(3, rx.size());
+    EXPECT_EQ(2, rx.peek(1));
+
+    EXPECT_TRUE(rx.pop(byte));
+    EXPECT_EQ(1, byte);
+    EXPECT_EQ(1, rx.free());
+    EXPECT_TRUE(rx.pop(byte));
+    EXPECT_TRUE(rx.pop(byte));
+    EXPECT_EQ(3, byte);
+    EXPECT_TRUE(rx.is_empty());
+  }
+}
+
+TEST(RingBuffer, ByteIndexWraps) {
+  RingBuffer<256> rx;
+  uint8_t byte;
+  for (unsigned ind = 0; ind < 1000; ind++) {
+    EXPECT_TRUE(rx.push(ind & 0xff));
+    EXPECT_TRUE(rx.pop(byte));
+    EXPECT_EQ(ind & 0xff, byte);
+  }
+  EXPECT_EQ(255, rx.free());
+}
+
+TEST(GcodeParser, LinearMove) {
+  MockGantry gantry;
+  GcodeParser parser(&gantry);
+  RingBuffer<64> rx;
+
+  EXPECT_CALL(gantry, set_cartesian(0, FloatEq(10)));
+  EXPECT_CALL(gantry, set_cartesian(1, FloatEq(-2.5f)));
+  EXPECT_CALL(gantry, set_cartesian(2, FloatEq(.125f)));
+  EXPECT_CALL(gantry, set_extruder(0, FloatEq(1.5f)));
+  EXPECT_CALL(gantry, set_speed(FloatEq(50)));
+
+  push(rx, "G1 X10 Y-2.5 Z.125 E1.5 F3000\n");
+  EXPECT_TRUE(parser.process(rx));
+  EXPECT_EQ(1u, parser.lines());
+  EXPECT_EQ(0u, parser.errors());
+}
+
+TEST(GcodeParser, OneLinePerProcess) {
+  MockGantry gantry;
+  GcodeParser parser(&gantry);
+  RingBuffer<64> rx;
+
+  push(rx, "g0x1\r\nG0 X2\nG0 X");
+
+  EXPECT_CALL(gantry, set_cartesian(0, FloatEq(1)));
+  EXPECT_TRUE(parser.process(rx));
+  EXPECT_CALL(gantry, set_cartesian(0, FloatEq(2)));
+  EXPECT_TRUE(parser.process(rx));
+
+  // Incomplete line is kept in parser state
+  EXPECT_FALSE(parser.process(rx));
+  push(rx, "3.\n");
+  EXPECT_CALL(gantry, set_cartesian(0, FloatEq(3)));
+  EXPECT_TRUE(parser.process(rx));
+  EXPECT_EQ(3u, parser.lines());
+}
+
+TEST(GcodeParser, SkipsCommentsLineNumbersAndChecksums) {
+  MockGantry gantry;
+  GcodeParser parser(&gantry);
+
+  EXPECT_CALL(gantry, set_cartesian(0, FloatEq(1)));
+  EXPECT_CALL(gantry, set_cartesian(1, FloatEq(2)));
+  EXPECT_CALL(gantry, set_cartesian(2, _)).Times(0);
+
+  const char *text =
+    "; comment only\n"
+    "\n"
+    "N10 G1 (move) X1 Y2 *57 Z3\n"
+    "(G1 Z4)\n";
+  for (const char *c = text; *c; c++) {
+    parser.consume(*c);
+  }
+  EXPECT_EQ(1u, parser.lines());
+  EXPECT_EQ(0u, parser.errors());
+}
+
+TEST(GcodeParser, Errors) {
+  MockGantry gantry;
+  GcodeParser parser(&gantry);
+
+  EXPECT_CALL(gantry, set_cartesian(_, _)).Times(0);
+  EXPECT_CALL(gantry, set_speed(_)).Times(0);
+
+  const char *text =
+    "G28\n"        // Unsupported
+    "M104 S200\n"  // Unsupported
+    "G1 X\n"       // Missing number
+    "G1 X1-\n"     // Malformed number
+    "G1 X1 # \n"   // Unknown character
+    "G1 G0 X1\n"   // Two commands
+    "X1 Y1\n"      // No command
+    "G65537 X1\n"  // Would truncate to G1
+    "G-1 X1\n"     // Signed command
+    "G+1 X1\n"
+    "M-104\n";
+  for (const char *c = text; *c; c++) {
+    EXPECT_FALSE(parser.consume(*c));
+  }
+  EXPECT_EQ(0u, parser.lines());
+  EXPECT_EQ(11u, parser.errors());
+}
+
+TEST(GcodeParser, Precision) {
+  MockGantry gantry;
+  GcodeParser parser(&gantry);
+
+  EXPECT_CALL(gantry, set_cartesian(0, FloatEq(123.456789f)));
+  EXPECT_CALL(gantry, set_cartesian(1, FloatEq(-0.000001f)));
+  EXPECT_CALL(gantry, set_cartesian(2, FloatEq(99999999)));
+
+  const char *text = "G1 X123.4567891234 Y-0.000001 Z99999999\n";
+  for (const char *c = text; *c; c++) {
+    parser.consume(*c);
+  }
+  EXPECT_EQ(1u, parser.lines());
+}
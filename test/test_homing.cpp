@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+
+#include <src/homing.h>
+#include <src/delta_gantry.h>
+#include <src/planner.h>
+#include <src/stepper_group.h>
+#include <src/trapezoid_ticker.h>
+#include <fake/timer.h>
+#include <fake/pin_io.h>
+
+class HomingTest : public ::testing::Test
+{
+public:
+  virtual void SetUp() {
+    for (unsigned stepper = 0; stepper < 4; stepper++) {
+      Stepper::Pins pins;
+      std::string name = std::to_string(stepper);
+      pins.enable = io.make_pin("enable" + name, true);
+      pins.step = io.make_pin("step" + name, true);
+      pins.dir = io.make_pin("dir" + name, true);
+      pins.endstop = io.make_pin("endstop" + name);
+      endstops.push_back(pins.endstop);
+      axisPins.push_back(pins);
+    }
+    group.reset(new StepperGroup(&io, axisPins.data(), axisPins.size(),
+				 &timer));
+    group->enable();
+    group->stop_on_endstop(0);
+
+    axes.assign(4, DeltaGantry::Axis{80, 1e-5, 1e-6});
+    const float radius = 100;
+    const float pi = 3.14159265f;
+    for (unsigned tower = 0; tower < 3; ++tower) {
+      float angle = pi/2 + tower*2*pi/3;
+      towers.push_back(DeltaGantry::Tower{
+	  {radius*cosf(angle), radius*sinf(angle), 0}, 215});
+    }
+    config = Homing::Config{100, 5, 2000, 100, 2};
+  }
+
+  /// Endstops are active from a fixed carriage position
+  void update_endstops() {
+    for (unsigned tower = 0; tower < 3; ++tower) {
+      if (group->position(tower) >= endstop_at[tower]) {
+	io.set(endstops[tower]);
+      }
+      else {
+	io.clear(endstops[tower]);
+      }
+    }
+  }
+
+  Homing::State run(Homing& homing) {
+    homing.start();
+    unsigned iterations = 0;
+    Homing::State state;
+    while ((state = homing.poll()) != Homing::State::DONE &&
+	   state != Homing::State::FAILED) {
+      for (unsigned tick = 0; tick < 4; ++tick) {
+	timer.fake_next();
+	update_endstops();
+      }
+      if (++iterations > 1000000) {
+	ADD_FAILURE() << "Homing does not finish";
+	break;
+      }
+    }
+    return state;
+  }
+
+protected:
+  fake::Timer timer;
+  fake::PinIo io;
+  std::vector<Stepper::Pins> axisPins;
+  std::unique_ptr<StepperGroup> group;
+  std::vector<PinIo::Pin> endstops;
+  std::vector<DeltaGantry::Axis> axes;
+  std::vector<DeltaGantry::Tower> towers;
+  Homing::Config config;
+  int endstop_at[3] = {2000, 3000, 2500};
+};
+
+TEST_F(HomingTest, HomesAllTowers) {
+  DeltaGantry gantry(axes, towers);
+  Planner planner(16, group->size());
+  TrapezoidTicker ticker(group.get(), &timer);
+  std::vector<int> home{20000, 20000, 20000};
+  Homing homing(group.get(), axes, home, &gantry, &planner, &ticker, config);
+  group->set_position(3, 123);
+
+  EXPECT_EQ(Homing::State::IDLE, homing.state());
+  ASSERT_EQ(Homing::State::DONE, run(homing));
+
+  for (unsigned tower = 0; tower < 3; ++tower) {
+    EXPECT_EQ(20000, group->position(tower));
+    EXPECT_EQ(Stepper::State::ACTIVE, group->state(tower));
+  }
+  EXPECT_EQ(123, group->position(3));
+  EXPECT_FALSE(ticker.is_running());
+  EXPECT_EQ(nullptr, planner.get_current_move());
+
+  // Gantry is at the home position of the towers
+  float cartesian[3];
+  ASSERT_TRUE(gantry.get_cartesian_from_steps({20000, 20000, 20000, 123},
+					      cartesian));
+  for (unsigned coord = 0; coord < 3; ++coord) {
+    EXPECT_FLOAT_EQ(cartesian[coord], gantry.get_cartesian(coord));
+  }
+
+  // Faster than approaching the farthest endstop at slow speed
+  float slow_time = endstop_at[1]/axes[1].steps_per_mm/config.slow_speed;
+  EXPECT_LT(timer.timestamp()*1e-6f, slow_time/4);
+}
+
+TEST_F(HomingTest, MovesAwayAfterHoming) {
+  DeltaGantry gantry(axes, towers);
+  Planner planner(16, group->size());
+  TrapezoidTicker ticker(group.get(), &timer);
+  std::vector<int> home{20000, 20000, 20000};
+  Homing homing(group.get(), axes, home, &gantry, &planner, &ticker, config);
+  ASSERT_EQ(Homing::State::DONE, run(homing));
+
+  // Endstops are still active, but do not stop towers moving away
+  planner.plan_move({-80, -80, -80, 0}, 1, 10, 1000, 0);
+  ticker.start(&planner);
+  while (ticker.is_running()) {
+    timer.fake_next();
+  }
+  for (unsigned tower = 0; tower < 3; ++tower) {
+    EXPECT_EQ(20000 - 80, group->position(tower));
+  }
+
+  // Endstops are still armed, towers stop when they come back
+  for (unsigned tower = 0; tower < 3; ++tower) {
+    endstop_at[tower] = 20000;
+  }
+  update_endstops();
+  planner.plan_move({160, 160, 160, 0}, 2, 10, 1000, 0);
+  ticker.start(&planner);
+  while (ticker.is_running()) {
+    timer.fake_next();
+    update_endstops();
+  }
+  for (unsigned tower = 0; tower < 3; ++tower) {
+    EXPECT_EQ(20000, group->position(tower));
+    EXPECT_EQ(Stepper::State::STOPPED, group->state(tower));
+  }
+}
+
+TEST_F(HomingTest, FailsWithoutEndstop) {
+  DeltaGantry gantry(axes, towers);
+  Planner planner(16, group->size());
+  TrapezoidTicker ticker(group.get(), &timer);
+  std::vector<int> home{20000, 20000, 20000};
+  Homing homing(group.get(), axes, home, &gantry, &planner, &ticker, config);
+  endstop_at[2] = 100000;
+
+  EXPECT_EQ(Homing::State::FAILED, run(homing));
+  EXPECT_EQ(8000, group->position(2));
+  EXPECT_EQ(2000, group->position(0));
+  EXPECT_FALSE(ticker.is_running());
+}
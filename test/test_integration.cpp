@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+
+#include <src/motion_pipeline.h>
+#include <src/delta_gantry.h>
+#include <src/planner.h>
+#include <src/stepper_group.h>
+#include <src/trapezoid_ticker.h>
+#include <fake/timer.h>
+#include <fake/pin_io.h>
+
+class IntegrationTest : public ::testing::Test
+{
+public:
+  virtual void SetUp() {
+    for (unsigned stepper = 0; stepper < 4; stepper++) {
+      Stepper::Pins pins;
+      std::string name = std::to_string(stepper);
+      pins.enable = io.make_pin("enable" + name, true);
+      pins.step = io.make_pin("step" + name, true);
+      pins.dir = io.make_pin("dir" + name, true);
+      pins.endstop = io.make_pin("endstop" + name);
+      axisPins.push_back(pins);
+    }
+    group.reset(new StepperGroup(&io, axisPins.data(), axisPins.size(),
+				 &timer));
+    group->enable();
+    group->stop_on_endstop(0);
+
+    axes.assign(4, DeltaGantry::Axis{80, 1e-5, 1e-6});
+    const float radius = 100;
+    const float pi = 3.14159265f;
+    for (unsigned tower = 0; tower < 3; ++tower) {
+      float angle = pi/2 + tower*2*pi/3;
+      towers.push_back(DeltaGantry::Tower{
+	  {radius*cosf(angle), radius*sinf(angle), 0}, 215});
+    }
+  }
+
+  std::vector<int> positions() const {
+    std::vector<int> steps;
+    for (unsigned axis = 0; axis < group->size(); ++axis) {
+      steps.push_back(group->position(axis));
+    }
+    return steps;
+  }
+
+protected:
+  fake::Timer timer;
+  fake::PinIo io;
+  std::vector<Stepper::Pins> axisPins;
+  std::unique_ptr<StepperGroup> group;
+  std::vector<DeltaGantry::Axis> axes;
+  std::vector<DeltaGantry::Tower> towers;
+};
+
+TEST_F(IntegrationTest, PipelineExecutesMoves) {
+  DeltaGantry gantry(axes, towers);
+  Planner planner(16, group->size());
+  TrapezoidTicker ticker(group.get(), &timer);
+  MotionPipeline pipeline(&gantry, &planner, &ticker, 4, group->size());
+
+  std::vector<int> start{20000, 20000, 20000, 0};
+  ASSERT_TRUE(gantry.set_position_from_steps(start));
+  for (unsigned axis = 0; axis < start.size(); ++axis) {
+    group->set_position(axis, start[axis]);
+  }
+
+  const float targets[][3] = {{3, 0, 0}, {3, 2, -1}};
+  const float z0 = gantry.get_cartesian(2);
+  for (auto& target : targets) {
+    gantry.set_speed(5);
+    gantry.set_cartesian(0, target[0]);
+    gantry.set_cartesian(1, target[1]);
+    gantry.set_cartesian(2, z0 + target[2]);
+
+    // Main loop: a time slice of motion work, then let the ticker run
+    unsigned iterations = 0;
+    do {
+      pipeline.poll();
+      for (unsigned tick = 0; tick < 4; ++tick) {
+	timer.fake_next();
+      }
+      ASSERT_LT(++iterations, 100000u);
+    } while (!pipeline.is_idle());
+
+    float cartesian[3];
+    ASSERT_TRUE(gantry.get_cartesian_from_steps(positions(), cartesian));
+    EXPECT_NEAR(target[0], cartesian[0], .05);
+    EXPECT_NEAR(target[1], cartesian[1], .05);
+    EXPECT_NEAR(z0 + target[2], cartesian[2], .05);
+  }
+
+  const MotionPipeline::Stats& stats = pipeline.stats();
+  EXPECT_GT(stats.moves, 30u);
+  EXPECT_GT(stats.stalls, 0u);
+  EXPECT_GE(stats.restarts, 2u);
+}
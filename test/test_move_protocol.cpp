@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include <src/move_encoder.h>
+#include <src/move_decoder.h>
+#include <src/planner.h>
+#include <src/ring_buffer.h>
+
+namespace {
+  Gantry::LinearMove make_move(std::vector<int> steps, float length,
+			       float speed, float acc, float entry) {
+    Gantry::LinearMove move;
+    move.steps = steps;
+    move.length = length;
+    move.cruise_speed = speed;
+    move.acceleration = acc;
+    move.entry_speed = entry;
+    return move;
+  }
+
+  unsigned decode(MoveDecoder& decoder, const std::vector<uint8_t>& data) {
+    unsigned count = 0;
+    for (uint8_t byte : data) {
+      count += decoder.consume(byte);
+    }
+    return count;
+  }
+}
+
+TEST(MoveProtocol, RoundTrip) {
+  MoveEncoder encoder(3);
+  Planner planner(8, 3);
+  MoveDecoder decoder(&planner, 3);
+  std::vector<uint8_t> data;
+
+  std::vector<Gantry::LinearMove> moves;
+  moves.push_back(make_move({1, -2, 3}, .1f, 30, 300, 0));
+  moves.push_back(make_move({-128, 127, 0}, .1f, 30, 300, 5));
+  moves.push_back(make_move({1000, -1000, 200}, .2f, 20, 300, 5));
+
+  encoder.header(data);
+  for (auto& move : moves) {
+    encoder.encode(move, data);
+  }
+
+  // Repeated fields and small steps are compact, the first move is a
+  // key move with positions. Framing is 4 bytes per record
+  EXPECT_EQ((4u + 2) + (4 + 2 + 3 + 12 + 16) + (4 + 2 + 3 + 4) +
+	    (4 + 2 + 6 + 8), data.size());
+
+  RingBuffer<256> rx;
+  for (uint8_t byte : data) {
+    ASSERT_TRUE(rx.push(byte));
+  }
+  EXPECT_EQ(3u, decoder.process(rx));
+  EXPECT_EQ(0u, decoder.errors());
+
+  for (auto& move : moves) {
+    const Move *planned = planner.get_current_move();
+    ASSERT_TRUE(planned != nullptr);
+    EXPECT_EQ(move.steps, planned->steps);
+    EXPECT_EQ(move.length, planned->length);
+    EXPECT_EQ(move.cruise_speed, planned->speed);
+    EXPECT_EQ(move.acceleration, planned->acceleration);
+    planner.next_move();
+  }
+}
+
+TEST(MoveProtocol, StopsWhenPlannerFull) {
+  MoveEncoder encoder(1);
+  Planner planner(4, 1);
+  MoveDecoder decoder(&planner, 1);
+  std::vector<uint8_t> data;
+
+  encoder.header(data);
+  for (int ind = 0; ind < 4; ind++) {
+    encoder.encode(make_move({ind}, 1, 1, 1, 0), data);
+  }
+
+  RingBuffer<128> rx;
+  for (uint8_t byte : data) {
+    ASSERT_TRUE(rx.push(byte));
+  }
+  // Room for a resync move is kept
+  EXPECT_EQ(2u, decoder.process(rx));
+  EXPECT_EQ(1u, planner.free_slots());
+  EXPECT_FALSE(rx.is_empty());
+
+  planner.next_move();
+  planner.next_move();
+  EXPECT_EQ(2u, decoder.process(rx));
+  EXPECT_TRUE(rx.is_empty());
+  EXPECT_EQ(2, planner.get_current_move()->steps[0]);
+}
+
+TEST(MoveProtocol, RejectsCorruptRecord) {
+  MoveEncoder encoder(2);
+  Planner planner(8, 2);
+  MoveDecoder decoder(&planner, 2);
+
+  std::vector<uint8_t> header, first, second;
+  encoder.header(header);
+  encoder.encode(make_move({5, 6}, 1, 2, 3, 0), first);
+  encoder.encode(make_move({7, 8}, 1, 2, 3, 0), second);
+
+  std::vector<uint8_t> third;
+  encoder.encode(make_move({1, 2}, 1, 2, 3, 0), third);
+
+  EXPECT_EQ(0u, decode(decoder, header));
+  first[3] ^= 1;
+  EXPECT_EQ(0u, decode(decoder, first));
+  EXPECT_EQ(1u, decoder.errors());
+
+  // Decoder finds next record, but drops moves after the gap
+  EXPECT_EQ(0u, decode(decoder, second));
+  EXPECT_EQ(1u, decoder.gaps());
+  EXPECT_EQ(2u, decoder.errors());
+  EXPECT_EQ(0u, decode(decoder, third));
+  EXPECT_EQ(nullptr, planner.get_current_move());
+}
+
+TEST(MoveProtocol, KeyMoveRestoresPosition) {
+  MoveEncoder encoder(2);
+  Planner planner(8, 2);
+  MoveDecoder decoder(&planner, 2);
+
+  std::vector<uint8_t> data;
+  encoder.header(data);
+  std::vector<std::vector<uint8_t>> records;
+  for (unsigned ind = 0; ind < move_protocol::key_interval; ind++) {
+    records.emplace_back();
+    encoder.encode(make_move({10, -5}, 1, 20, 300, 10), records.back());
+  }
+  // Second key move
+  records.emplace_back();
+  encoder.encode(make_move({4, 2}, 2, 20, 300, 10), records.back());
+  EXPECT_EQ(move_protocol::key_move_type, records.front()[1]);
+  EXPECT_EQ(move_protocol::key_move_type, records.back()[1]);
+
+  EXPECT_EQ(0u, decode(decoder, data));
+  EXPECT_EQ(1u, decode(decoder, records[0]));
+  EXPECT_EQ(1u, decode(decoder, records[1]));
+  planner.next_move();
+  planner.next_move();
+  // Records 2 to 4 are lost, the rest until the key move are dropped
+  for (unsigned ind = 5; ind < records.size() - 1; ind++) {
+    EXPECT_EQ(0u, decode(decoder, records[ind]));
+  }
+  EXPECT_EQ(1u, decoder.gaps());
+
+  EXPECT_EQ(1u, decode(decoder, records.back()));
+  const Move *resync = planner.get_current_move();
+  ASSERT_TRUE(resync != nullptr);
+  int lost = move_protocol::key_interval - 2;
+  EXPECT_EQ(std::vector<int>({10*lost, -5*lost}), resync->steps);
+  // Length scaled from the key move by the steps of axis 0
+  EXPECT_FLOAT_EQ(2.0f*10*lost/4, resync->length);
+  // Starts and ends at rest
+  EXPECT_EQ(0, planner.get_current_entry_speed_sqr());
+  EXPECT_EQ(0, planner.get_current_exit_speed_sqr());
+  planner.next_move();
+  EXPECT_EQ(std::vector<int>({4, 2}), planner.get_current_move()->steps);
+}
+
+TEST(MoveProtocol, TooManyAxes) {
+  Planner planner(8, move_protocol::max_axes + 1);
+  EXPECT_DEATH(MoveDecoder(&planner, move_protocol::max_axes + 1),
+	       "max_axes");
+}
+
+TEST(MoveProtocol, SplitsLongMoves) {
+  MoveEncoder encoder(2);
+  Planner planner(8, 2);
+  MoveDecoder decoder(&planner, 2);
+
+  std::vector<uint8_t> data;
+  encoder.header(data);
+  encoder.encode(make_move({70000, -3}, 10, 20, 300, 5), data);
+  EXPECT_EQ(3u, decode(decoder, data));
+  EXPECT_EQ(0u, decoder.errors());
+
+  int total[2] = {0, 0};
+  for (unsigned part = 0; part < 3; part++) {
+    const Move *move = planner.get_current_move();
+    ASSERT_TRUE(move != nullptr);
+    EXPECT_GE(MoveEncoder::max_steps, std::abs(move->steps[0]));
+    EXPECT_FLOAT_EQ(10.0f/3, move->length);
+    total[0] += move->steps[0];
+    total[1] += move->steps[1];
+    planner.next_move();
+  }
+  EXPECT_EQ(70000, total[0]);
+  EXPECT_EQ(-3, total[1]);
+}
+
+TEST(MoveProtocol, RequiresMatchingHeader) {
+  MoveEncoder encoder(2);
+  Planner planner(8, 3);
+  MoveDecoder decoder(&planner, 3);
+
+  std::vector<uint8_t> data;
+  encoder.header(data);
+  encoder.encode(make_move({5, 6}, 1, 2, 3, 0), data);
+
+  EXPECT_EQ(0u, decode(decoder, data));
+  EXPECT_LE(1u, decoder.errors());
+  EXPECT_EQ(nullptr, planner.get_current_move());
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <src/pin_io.h>
+#include <fake/pin_io.h>
+
+namespace {
+  /// PinIo with only the single pin operations
+  class SinglePinIo : public PinIo {
+  public:
+    SinglePinIo() : levels() {}
+    void set(Pin pin) override { levels[pin.pin_no] = true; calls++; }
+    void clear(Pin pin) override { levels[pin.pin_no] = false; calls++; }
+    bool get(Pin pin) override { return levels[pin.pin_no]; }
+
+    bool levels[24];
+    unsigned calls = 0;
+  };
+}
+
+TEST(PinIo, port_and_bit) {
+  EXPECT_EQ(0, PinIo::port(PinIo::Pin{7}));
+  EXPECT_EQ(0x80, PinIo::bit(PinIo::Pin{7}));
+  EXPECT_EQ(2, PinIo::port(PinIo::Pin{17}));
+  EXPECT_EQ(0x02, PinIo::bit(PinIo::Pin{17}));
+}
+
+TEST(PinIo, default_mask_operations) {
+  SinglePinIo io;
+  io.set_mask(1, 0x81);
+  EXPECT_TRUE(io.levels[8]);
+  EXPECT_TRUE(io.levels[15]);
+  EXPECT_FALSE(io.levels[9]);
+  EXPECT_EQ(2u, io.calls);
+
+  io.write_mask(1, 0x03, 0x02);
+  EXPECT_FALSE(io.levels[8]);
+  EXPECT_TRUE(io.levels[9]);
+  EXPECT_TRUE(io.levels[15]);
+
+  io.clear_mask(1, 0xff);
+  for (int pin = 8; pin < 16; pin++) {
+    EXPECT_FALSE(io.levels[pin]);
+  }
+}
+
+class PinSetTest : public ::testing::Test
+{
+public:
+  virtual void SetUp() {
+    for (int pin = 0; pin < 16; pin++) {
+      pins.push_back(io.make_pin("pin" + std::to_string(pin)));
+    }
+  }
+
+protected:
+  fake::PinIo io;
+  std::vector<PinIo::Pin> pins;
+};
+
+TEST_F(PinSetTest, one_write_per_port) {
+  PinSet set;
+  EXPECT_EQ(0u, set.add(pins[1]));
+  EXPECT_EQ(1u, set.add(pins[3]));
+  EXPECT_EQ(2u, set.add(pins[9]));
+  EXPECT_EQ(3u, set.add(pins[2]));
+  EXPECT_EQ(4u, set.size());
+
+  set.set(&io, 0x0b);
+  ASSERT_EQ(1u, io.mask_writes().size());
+  EXPECT_EQ(0, io.mask_writes()[0].port);
+  EXPECT_EQ(0x0e, io.mask_writes()[0].mask);
+  EXPECT_EQ(0x0e, io.mask_writes()[0].value);
+  EXPECT_TRUE(io.get(pins[1]));
+  EXPECT_TRUE(io.get(pins[2]));
+  EXPECT_TRUE(io.get(pins[3]));
+  EXPECT_FALSE(io.get(pins[9]));
+
+  io.clear_mask_writes();
+  set.set(&io, 0x0f);
+  ASSERT_EQ(2u, io.mask_writes().size());
+  EXPECT_EQ(1, io.mask_writes()[1].port);
+  EXPECT_EQ(0x02, io.mask_writes()[1].mask);
+  EXPECT_TRUE(io.get(pins[9]));
+
+  io.clear_mask_writes();
+  set.clear(&io, 0x05);
+  ASSERT_EQ(2u, io.mask_writes().size());
+  EXPECT_EQ(0x02, io.mask_writes()[0].mask);
+  EXPECT_EQ(0, io.mask_writes()[0].value);
+  EXPECT_FALSE(io.get(pins[1]));
+  EXPECT_TRUE(io.get(pins[3]));
+  EXPECT_FALSE(io.get(pins[9]));
+}
+
+TEST_F(PinSetTest, write) {
+  PinSet set;
+  set.add(pins[0]);
+  set.add(pins[8]);
+  set.add(pins[4]);
+
+  set.write(&io, 0x07, 0x06);
+  ASSERT_EQ(2u, io.mask_writes().size());
+  EXPECT_EQ(0x11, io.mask_writes()[0].mask);
+  EXPECT_EQ(0x10, io.mask_writes()[0].value);
+  EXPECT_FALSE(io.get(pins[0]));
+  EXPECT_TRUE(io.get(pins[4]));
+  EXPECT_TRUE(io.get(pins[8]));
+
+  // Unselected pins are untouched
+  set.write(&io, 0x02, 0x00);
+  EXPECT_TRUE(io.get(pins[4]));
+  EXPECT_FALSE(io.get(pins[8]));
+}
+
+TEST_F(PinSetTest, full) {
+  PinSet set;
+  for (unsigned pin = 0; pin < PinSet::max_pins; pin++) {
+    EXPECT_EQ(pin, set.add(pins[pin]));
+  }
+  EXPECT_EQ(unsigned(PinSet::max_pins), set.add(pins[15]));
+}
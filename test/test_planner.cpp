@@ -72,3 +72,39 @@ TEST(Planner, PlanInitialLimited) {
   EXPECT_EQ(1, planner.get_current_entry_speed_sqr());
 }
 
+
+TEST(Planner, FreeSlots) {
+  Planner planner(4, 1);
+  std::vector<int> steps(1);
+
+  EXPECT_EQ(3u, planner.free_slots());
+  planner.plan_move(steps, 1, 1, 1, 0);
+  planner.plan_move(steps, 1, 1, 1, 0);
+  EXPECT_EQ(1u, planner.free_slots());
+  planner.plan_move(steps, 1, 1, 1, 0);
+  EXPECT_EQ(0u, planner.free_slots());
+  EXPECT_TRUE(planner.is_buffer_full());
+
+  // Wrap around
+  planner.next_move();
+  planner.next_move();
+  EXPECT_EQ(2u, planner.free_slots());
+  planner.plan_move(steps, 1, 1, 1, 0);
+  EXPECT_EQ(1u, planner.free_slots());
+}
+
+
+TEST(Planner, Clear) {
+  Planner planner(4, 1);
+  std::vector<int> steps(1);
+
+  planner.plan_move(steps, 1, 10, 10, 0);
+  planner.plan_move(steps, 1, 10, 10, 10);
+  planner.clear();
+  EXPECT_EQ(nullptr, planner.get_current_move());
+  EXPECT_EQ(3u, planner.free_slots());
+
+  planner.plan_move(steps, 1, 10, 10, 10);
+  EXPECT_EQ(0, planner.get_current_entry_speed_sqr());
+  EXPECT_EQ(0, planner.get_current_exit_speed_sqr());
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include <src/profile_analysis.h>
+#include <src/exact_trapezoid_generator.h>
+
+TEST(ProfileAnalysis, ideal_trapezoid) {
+  // 10000 steps/s^2 to 1000 steps/s takes 50 steps and 0.1 s
+  ProfileSpec spec{1000, 0, 0, 1000, 10000};
+  EXPECT_DOUBLE_EQ(0.2 + 0.9, ProfileAnalyzer::ideal_time(spec));
+  EXPECT_DOUBLE_EQ(1000, ProfileAnalyzer::ideal_velocity(spec, 500));
+  EXPECT_DOUBLE_EQ(std::sqrt(2*10000*10.0),
+		   ProfileAnalyzer::ideal_velocity(spec, 10));
+  EXPECT_DOUBLE_EQ(std::sqrt(2*10000*10.0),
+		   ProfileAnalyzer::ideal_velocity(spec, 990));
+
+  // Triangle, peak at sqrt(2*10000*20)
+  ProfileSpec triangle{40, 0, 0, 1000, 10000};
+  EXPECT_DOUBLE_EQ(2*std::sqrt(2*10000*20.0)/10000,
+		   ProfileAnalyzer::ideal_time(triangle));
+}
+
+TEST(ProfileAnalysis, feasible) {
+  // 1 step at 1000 steps/s^2 changes rate^2 by 2000
+  EXPECT_TRUE(ProfileAnalyzer::is_feasible(ProfileSpec{1, 0, 0, 100, 1000}));
+  EXPECT_TRUE(ProfileAnalyzer::is_feasible(ProfileSpec{1, 40, 20, 100, 1000}));
+  EXPECT_FALSE(ProfileAnalyzer::is_feasible(ProfileSpec{1, 50, 0, 100, 1000}));
+  EXPECT_FALSE(ProfileAnalyzer::is_feasible(
+    ProfileSpec{1, 0, 50000, 50000, 1000}));
+}
+
+TEST(ProfileAnalysis, constant_speed) {
+  ProfileAnalyzer analyzer(1e6f);
+  ProfileSpec spec{100, 1000, 1000, 1000, 10000};
+  const ProfileReport& report = analyzer.analyze(spec);
+
+  EXPECT_EQ(100u, analyzer.last_delays().size());
+  EXPECT_NEAR(0.1, report.total_time, 1e-9);
+  EXPECT_NEAR(0, report.time_error, 1e-9);
+  EXPECT_NEAR(0, report.peak_velocity_error, 1e-9);
+  EXPECT_NEAR(0, report.peak_acceleration, 1e-9);
+  EXPECT_EQ(0u, report.max_asymmetry);
+}
+
+namespace {
+  /// Generator replaying given delays
+  struct Replay {
+    std::vector<std::uint32_t> delays;
+    std::size_t next;
+    bool is_done() {
+      return next == delays.size();
+    }
+    std::uint32_t next_delay() {
+      return delays[next++];
+    }
+  };
+}
+
+TEST(ProfileAnalysis, asymmetry_and_acceleration) {
+  ProfileAnalyzer analyzer(1e6f);
+  ProfileSpec spec{4, 0, 0, 1000, 1e6f};
+  const ProfileReport& report = analyzer.analyze(spec,
+						 Replay{{1000, 500, 510, 990}, 0});
+  EXPECT_EQ(10u, report.max_asymmetry);
+  // From 1000 to 2000 steps/s in 750 us
+  EXPECT_NEAR(1000/750e-6/1e6, report.peak_acceleration, 1e-3);
+  EXPECT_DOUBLE_EQ(3000e-6, report.total_time);
+}
+
+TEST(ProfileAnalysis, start_stop) {
+  ProfileAnalyzer analyzer(1e6f);
+  analyzer.set_record_curves(true);
+  ProfileSpec spec{2000, 0, 0, 5000, 50000};
+
+  ProfileReport exact = analyzer.analyze(
+    spec, ExactTrapezoidGenerator(spec.steps, spec.entry_rate,
+				  spec.exit_rate, spec.nominal_rate,
+				  1e6f, spec.acc));
+  ASSERT_EQ(2000u, analyzer.curve().size());
+  EXPECT_LT(analyzer.curve()[0].velocity, analyzer.curve()[1].velocity);
+  EXPECT_NEAR(5000, analyzer.curve()[1000].velocity, 1);
+  EXPECT_NEAR(0, analyzer.curve()[1000].acceleration, 1);
+  EXPECT_GT(0, analyzer.curve()[1990].acceleration);
+  EXPECT_LE(exact.max_asymmetry, 1u);
+  EXPECT_LT(std::fabs(exact.time_error), 1e-5);
+
+  // Ramp recurrence deviates more from the analytic trapezoid
+  ProfileReport ramp = analyzer.analyze(spec);
+  EXPECT_LT(std::fabs(exact.time_error), std::fabs(ramp.time_error));
+  EXPECT_LT(exact.peak_velocity_error, ramp.peak_velocity_error);
+}
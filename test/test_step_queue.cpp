@@ -0,0 +1,292 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <memory>
+
+#include <src/step_queue.h>
+#include <src/step_queue_ticker.h>
+#include <src/step_producer.h>
+#include <src/trapezoid_generator.h>
+#include <src/planner.h>
+#include <src/stepper.h>
+#include <src/stepper_group.h>
+#include <src/trapezoid_ticker.h>
+#include <fake/timer.h>
+#include <fake/pin_io.h>
+
+namespace {
+  /// Step pulse seen on the pins
+  struct PinStep {
+    std::uint32_t time;
+    std::uint8_t step_pin;
+    bool dir_level;
+  };
+
+  /// Rising step edges recorded by io, with the direction pin level
+  /** Fails if a direction pin changes while its step pin is high.
+   */
+  std::vector<PinStep> pin_steps(const fake::PinIo& io,
+				 const std::vector<Stepper::Pins>& pins) {
+    std::vector<PinStep> steps;
+    std::vector<bool> levels(256, false);
+    for (const auto& edge : io.edges()) {
+      levels[edge.pin_no] = edge.level;
+      for (const auto& axis : pins) {
+	if (edge.pin_no == axis.dir.pin_no) {
+	  EXPECT_FALSE(levels[axis.step.pin_no]) << "at " << edge.time;
+	}
+	if (edge.level && edge.pin_no == axis.step.pin_no) {
+	  steps.push_back(PinStep{edge.time, edge.pin_no,
+		levels[axis.dir.pin_no]});
+	}
+      }
+    }
+    return steps;
+  }
+
+  /// Expand queued runs into absolute step times
+  std::vector<std::uint32_t> expand(StepQueue& queue) {
+    std::vector<std::uint32_t> times;
+    std::uint32_t time = 0;
+    while (const StepRun *run = queue.front()) {
+      std::uint32_t interval = run->interval;
+      for (unsigned step = 0; step < run->count; step++) {
+	time += interval;
+	times.push_back(time);
+	interval += run->add;
+      }
+      queue.pop();
+    }
+    return times;
+  }
+}
+
+TEST(StepCompressor, LinearIsOneRun) {
+  StepQueue queue(4);
+  StepCompressor compressor(&queue, 0);
+
+  for (std::uint32_t interval = 100; interval > 50; interval -= 10) {
+    compressor.push(interval, true);
+  }
+  compressor.flush();
+
+  ASSERT_TRUE(queue.front() != nullptr);
+  EXPECT_EQ(100u, queue.front()->interval);
+  EXPECT_EQ(5u, queue.front()->count);
+  EXPECT_EQ(-10, queue.front()->add);
+  EXPECT_EQ(1u, compressor.runs());
+
+  std::vector<std::uint32_t> expected{100, 190, 270, 340, 400};
+  EXPECT_EQ(expected, expand(queue));
+}
+
+TEST(StepCompressor, DirectionChangeSplitsRun) {
+  StepQueue queue(4);
+  StepCompressor compressor(&queue, 10);
+
+  compressor.push(100, true);
+  compressor.push(100, true);
+  compressor.push(100, false);
+  compressor.flush();
+
+  ASSERT_TRUE(queue.front() != nullptr);
+  EXPECT_TRUE(queue.front()->direction);
+  EXPECT_EQ(2u, queue.front()->count);
+  queue.pop();
+  ASSERT_TRUE(queue.front() != nullptr);
+  EXPECT_FALSE(queue.front()->direction);
+  EXPECT_EQ(1u, queue.front()->count);
+}
+
+TEST(StepCompressor, ErrorBoundedOnRamp) {
+  const std::uint32_t tolerance = 2;
+  StepQueue queue(1000);
+  StepCompressor compressor(&queue, tolerance);
+
+  TrapezoidGenerator generator(TrapezoidParameters(2000, 0, 0, 20000, 1e6f,
+						   1e5f));
+  std::vector<std::uint32_t> times;
+  std::uint32_t time = 0;
+  while (!generator.is_done()) {
+    std::uint32_t delay = generator.next_delay();
+    compressor.push(delay, true);
+    time += delay;
+    times.push_back(time);
+  }
+  compressor.flush();
+
+  std::vector<std::uint32_t> result = expand(queue);
+  ASSERT_EQ(times.size(), result.size());
+  for (unsigned ind = 0; ind < times.size(); ind++) {
+    ASSERT_LE(std::abs(static_cast<int>(times[ind] - result[ind])),
+	      static_cast<int>(tolerance)) << ind;
+  }
+  EXPECT_LT(compressor.runs(), times.size()/5);
+}
+
+class StepQueueTickerTest : public ::testing::Test
+{
+public:
+  virtual void SetUp() {
+    for (unsigned stepper = 0; stepper < 4; stepper++) {
+      Stepper::Pins pins;
+      std::string name = std::to_string(stepper);
+      pins.enable = io.make_pin("enable" + name);
+      pins.step = io.make_pin("step" + name);
+      pins.dir = io.make_pin("dir" + name);
+      pins.endstop = io.make_pin("endstop" + name);
+      axisPins.push_back(pins);
+      queues.emplace_back(StepQueue(16));
+    }
+    // Edges from the start, pin_steps() needs the initial directions
+    io.set_clock(&timer);
+    group.reset(new StepperGroup(&io, axisPins.data(), axisPins.size(),
+				 &timer));
+    group->enable();
+
+    for (auto& queue : queues) {
+      queuePtrs.push_back(&queue);
+    }
+  }
+
+protected:
+  fake::Timer timer;
+  fake::PinIo io;
+  std::vector<Stepper::Pins> axisPins;
+  std::unique_ptr<StepperGroup> group;
+  std::vector<StepQueue> queues;
+  std::vector<StepQueue*> queuePtrs;
+};
+
+TEST_F(StepQueueTickerTest, StepsAtQueuedTimes) {
+  StepQueueTicker ticker(group.get(), queuePtrs, &timer);
+  queues[0].push(StepRun{100, 3, 10, true});
+  queues[1].push(StepRun{150, 1, 0, false});
+
+  ticker.start();
+  unsigned interrupts = 0;
+  timer.reset_busy();
+  while (timer.fake_next()) {
+    interrupts++;
+  }
+
+  // The time base starts after the direction setup time
+  std::vector<PinStep> steps = pin_steps(io, axisPins);
+  ASSERT_EQ(4u, steps.size());
+  std::vector<std::uint32_t> expected{10 + 100, 10 + 150, 10 + 210,
+				      10 + 330};
+  for (unsigned ind = 0; ind < steps.size(); ind++) {
+    EXPECT_EQ(expected[ind], steps[ind].time) << ind;
+  }
+  EXPECT_EQ(3, group->position(0));
+  EXPECT_EQ(-1, group->position(1));
+  EXPECT_FALSE(ticker.is_running());
+
+  // One interrupt to load the runs and one per step, the last of which
+  // ends the ticker. Every pulse is released in its own interrupt, the
+  // fake timer takes no time for the bookkeeping so all of the pulse
+  // width is busy waited.
+  const std::uint32_t pulse_width = 2e-6f * timer.frequency();
+  EXPECT_EQ(4u, interrupts);
+  EXPECT_EQ(4*pulse_width, timer.busy());
+  EXPECT_EQ(pulse_width, timer.max_busy());
+  for (const auto& edge : io.edges()) {
+    if (edge.pin_no == axisPins[0].step.pin_no && !edge.level) {
+      EXPECT_TRUE(edge.time == 10 + 100 + pulse_width ||
+		  edge.time == 10 + 210 + pulse_width ||
+		  edge.time == 10 + 330 + pulse_width) << edge.time;
+    }
+  }
+}
+
+TEST_F(StepQueueTickerTest, SimultaneousStepsShareInterrupt) {
+  StepQueueTicker ticker(group.get(), queuePtrs, &timer);
+  for (auto& queue : queues) {
+    queue.push(StepRun{100, 10, 0, true});
+  }
+
+  ticker.start();
+  unsigned interrupts = 0;
+  while (timer.fake_next()) {
+    interrupts++;
+  }
+
+  for (unsigned axis = 0; axis < group->size(); axis++) {
+    EXPECT_EQ(10, group->position(axis));
+  }
+  // All axes step in the same interrupt, the last ends the ticker
+  EXPECT_EQ(10u, interrupts);
+}
+
+TEST_F(StepQueueTickerTest, SameStepsAsTrapezoidTicker) {
+  std::vector<int> steps{1,2,-3,10};
+  std::vector<int> steps2{-2,-3,2,-9};
+  Planner planner(16, group->size());
+  planner.plan_move(steps, 1, 10, 100, 1);
+  planner.plan_move(steps2, 1, 20, 100, 1);
+
+  // Without tolerance the compressed runs keep exact step times
+  StepProducer producer(queuePtrs, timer.frequency(), 0);
+  StepQueueTicker ticker(group.get(), queuePtrs, &timer);
+
+  // Main loop refills queues while ticker runs
+  unsigned interrupts = 0;
+  bool done = false;
+  do {
+    done = producer.fill(&planner);
+    ticker.start();
+    for (unsigned tick = 0; tick < 10 && timer.fake_next(); tick++) {
+      interrupts++;
+    }
+  } while (!done || ticker.is_running());
+
+  for (unsigned ind = 0; ind < steps.size(); ind++) {
+    EXPECT_EQ(steps[ind]+steps2[ind], group->position(ind));
+  }
+
+  // Same moves through TrapezoidTicker, on pins with the same numbers
+  fake::Timer trapezoid_timer;
+  fake::PinIo trapezoid_io;
+  std::vector<Stepper::Pins> pins;
+  for (unsigned ind = 0; ind < group->size(); ind++) {
+    std::string name = std::to_string(ind);
+    Stepper::Pins axis;
+    axis.enable = trapezoid_io.make_pin("enable" + name);
+    axis.step = trapezoid_io.make_pin("step" + name);
+    axis.dir = trapezoid_io.make_pin("dir" + name);
+    axis.endstop = trapezoid_io.make_pin("endstop" + name);
+    pins.push_back(axis);
+  }
+  trapezoid_io.set_clock(&trapezoid_timer);
+  StepperGroup trapezoid_group(&trapezoid_io, pins.data(), pins.size(),
+			       &trapezoid_timer);
+  trapezoid_group.enable();
+  planner.plan_move(steps, 1, 10, 100, 1);
+  planner.plan_move(steps2, 1, 20, 100, 1);
+  TrapezoidTicker trapezoid(&trapezoid_group, &trapezoid_timer);
+  trapezoid.start(&planner);
+  unsigned trapezoid_interrupts = 0;
+  while (trapezoid_timer.fake_next()) {
+    trapezoid_interrupts++;
+  }
+
+  // Every step on the same pin, with the same direction and at the
+  // same time. Queued intervals are positive, so the first step, due
+  // at the start of the time base, is one tick late; the deviation is
+  // carried into the next run.
+  std::vector<PinStep> queued = pin_steps(io, axisPins);
+  std::vector<PinStep> ticked = pin_steps(trapezoid_io, pins);
+  unsigned total = 0;
+  for (unsigned ind = 0; ind < steps.size(); ind++) {
+    total += std::abs(steps[ind]) + std::abs(steps2[ind]);
+  }
+  ASSERT_EQ(total, queued.size());
+  ASSERT_EQ(total, ticked.size());
+  for (unsigned ind = 0; ind < total; ind++) {
+    EXPECT_EQ(ticked[ind].step_pin, queued[ind].step_pin) << ind;
+    EXPECT_EQ(ticked[ind].dir_level, queued[ind].dir_level) << ind;
+    EXPECT_EQ(ticked[ind].time + (ind == 0), queued[ind].time) << ind;
+  }
+
+  // One interrupt per event, where the SPLIT pulses take two
+  EXPECT_LT(interrupts, trapezoid_interrupts*3/4);
+}
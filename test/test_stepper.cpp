@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <src/stepper.h>
+#include <src/static_stepper.h>
 #include <fake/pin_io.h>
 
 class StepperTest : public ::testing::Test
@@ -100,3 +101,194 @@ TEST_F(StepperTest, StopOnEndstop) {
   EXPECT_EQ(1, stepper.position());
   stepper.unstep();
 }
+
+
+TEST_F(StepperTest, PolledTriggerPosition) {
+  Stepper stepper(&io, pins);
+  stepper.enable();
+  EXPECT_FALSE(stepper.is_endstop_triggered());
+
+  stepper.step();
+  stepper.unstep();
+  io.set(pins.endstop);
+  stepper.step();
+  stepper.unstep();
+  EXPECT_EQ(Stepper::State::STOPPED, stepper.state());
+  EXPECT_TRUE(stepper.is_endstop_triggered());
+  EXPECT_EQ(2, stepper.trigger_position());
+}
+
+TEST_F(StepperTest, EndstopInterrupt) {
+  Stepper stepper(&io, pins);
+  stepper.use_endstop_interrupt(true);
+  stepper.enable();
+
+  // Endstop pin is not polled in interrupt mode
+  io.set(pins.endstop);
+  stepper.step();
+  stepper.unstep();
+  EXPECT_EQ(Stepper::State::ACTIVE, stepper.state());
+
+  stepper.step();
+  stepper.on_endstop();
+  EXPECT_EQ(Stepper::State::STEPPING, stepper.state());
+  EXPECT_TRUE(stepper.is_endstop_triggered());
+  EXPECT_EQ(2, stepper.trigger_position());
+  stepper.unstep();
+  EXPECT_FALSE(io.get(pins.step));
+  EXPECT_EQ(Stepper::State::STOPPED, stepper.state());
+
+  // First trigger is kept until cleared
+  stepper.set_position(10);
+  stepper.on_endstop();
+  EXPECT_EQ(2, stepper.trigger_position());
+  io.clear(pins.endstop);
+  stepper.clear_endstop_trigger();
+  EXPECT_FALSE(stepper.is_endstop_triggered());
+  stepper.enable();
+  stepper.on_endstop();
+  EXPECT_EQ(Stepper::State::STOPPED, stepper.state());
+  EXPECT_EQ(10, stepper.trigger_position());
+}
+
+TEST_F(StepperTest, EndstopInterruptArmedWhileActive) {
+  Stepper stepper(&io, pins);
+  stepper.enable();
+  stepper.set_position(5);
+
+  // No pin change will come for an endstop that is already active
+  io.set(pins.endstop);
+  stepper.use_endstop_interrupt(true);
+  EXPECT_TRUE(stepper.is_endstop_triggered());
+  EXPECT_EQ(5, stepper.trigger_position());
+  EXPECT_EQ(Stepper::State::STOPPED, stepper.state());
+
+  stepper.stop_on_endstop(false);
+  stepper.enable();
+  stepper.step();
+  stepper.unstep();
+  stepper.clear_endstop_trigger();
+  EXPECT_TRUE(stepper.is_endstop_triggered());
+  EXPECT_EQ(6, stepper.trigger_position());
+  EXPECT_EQ(Stepper::State::ACTIVE, stepper.state());
+
+  io.clear(pins.endstop);
+  stepper.clear_endstop_trigger();
+  EXPECT_FALSE(stepper.is_endstop_triggered());
+}
+
+TEST_F(StepperTest, EndstopInterruptWithoutStop) {
+  Stepper stepper(&io, pins);
+  stepper.use_endstop_interrupt(true);
+  stepper.stop_on_endstop(false);
+  stepper.enable();
+
+  stepper.on_endstop();
+  EXPECT_EQ(Stepper::State::ACTIVE, stepper.state());
+  EXPECT_TRUE(stepper.is_endstop_triggered());
+  stepper.step();
+  stepper.unstep();
+  EXPECT_EQ(1, stepper.position());
+  EXPECT_EQ(0, stepper.trigger_position());
+}
+
+namespace {
+  /// Compile time pin on host, level shared by all users of the type
+  template <int N>
+  struct StaticPin {
+    static void set() { level = true; }
+    static void clear() { level = false; }
+    static bool get() { return level; }
+    static bool level;
+  };
+
+  template <int N>
+  bool StaticPin<N>::level = true;
+
+  typedef StaticPin<0> Enable;
+  typedef StaticPin<1> Step;
+  typedef StaticPin<2> Dir;
+  typedef StaticPin<3> Endstop;
+  typedef StaticStepper<Enable, Step, Dir, Endstop> TestStaticStepper;
+}
+
+TEST(StaticStepper, Init) {
+  Endstop::level = false;
+  TestStaticStepper stepper;
+  EXPECT_FALSE(Enable::level);
+  EXPECT_FALSE(Step::level);
+  EXPECT_FALSE(Dir::level);
+  EXPECT_EQ(Stepper::State::DISABLED, stepper.state());
+}
+
+TEST(StaticStepper, StepAndDir) {
+  Endstop::level = false;
+  TestStaticStepper stepper;
+
+  stepper.step();
+  EXPECT_FALSE(Step::level);
+  stepper.enable();
+  EXPECT_TRUE(Enable::level);
+  stepper.set_position(10);
+  stepper.set_direction(false);
+  EXPECT_FALSE(Dir::level);
+  stepper.step();
+  EXPECT_EQ(Stepper::State::STEPPING, stepper.state());
+  EXPECT_TRUE(Step::level);
+  stepper.unstep();
+  EXPECT_FALSE(Step::level);
+  EXPECT_EQ(9, stepper.position());
+
+  stepper.set_direction(true);
+  EXPECT_TRUE(Dir::level);
+  stepper.step();
+  stepper.unstep();
+  EXPECT_EQ(10, stepper.position());
+  stepper.disable();
+  EXPECT_FALSE(Enable::level);
+}
+
+TEST(StaticStepper, StopOnEndstop) {
+  Endstop::level = false;
+  TestStaticStepper stepper;
+  stepper.enable();
+  EXPECT_FALSE(stepper.is_endstop_active());
+
+  Endstop::level = true;
+  EXPECT_TRUE(stepper.is_endstop_active());
+  stepper.step();
+  stepper.unstep();
+  EXPECT_EQ(Stepper::State::STOPPED, stepper.state());
+  stepper.step();
+  EXPECT_FALSE(Step::level);
+  EXPECT_EQ(1, stepper.position());
+
+  stepper.stop_on_endstop(false);
+  stepper.enable();
+  stepper.step();
+  stepper.unstep();
+  EXPECT_EQ(Stepper::State::ACTIVE, stepper.state());
+  EXPECT_EQ(2, stepper.position());
+}
+
+TEST(StaticStepper, EndstopInterrupt) {
+  Endstop::level = false;
+  TestStaticStepper stepper;
+  stepper.use_endstop_interrupt(true);
+  stepper.enable();
+
+  stepper.step();
+  stepper.unstep();
+  stepper.on_endstop();
+  EXPECT_EQ(Stepper::State::STOPPED, stepper.state());
+  EXPECT_TRUE(stepper.is_endstop_triggered());
+  EXPECT_EQ(1, stepper.trigger_position());
+  stepper.clear_endstop_trigger();
+  EXPECT_FALSE(stepper.is_endstop_triggered());
+
+  // Rearming on an active endstop triggers at once
+  Endstop::level = true;
+  stepper.clear_endstop_trigger();
+  EXPECT_TRUE(stepper.is_endstop_triggered());
+  Endstop::level = false;
+}
@@ -0,0 +1,253 @@
+#include <gtest/gtest.h>
+
+#include <src/stepper_group.h>
+#include <fake/pin_io.h>
+#include <fake/timer.h>
+
+class StepperGroupTest : public ::testing::Test
+{
+public:
+  virtual void SetUp() {
+    PinIo::Pin enable = io.make_pin("enable", true);
+    const char *names[] = {"x", "y", "z"};
+    for (int axis = 0; axis < 3; axis++) {
+      pins[axis].enable = enable;
+      pins[axis].step = io.make_pin(std::string(names[axis]) + "_step", true);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      pins[axis].dir = io.make_pin(std::string(names[axis]) + "_dir");
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      pins[axis].endstop = io.make_pin(std::string(names[axis]) + "_min");
+    }
+  }
+
+protected:
+  fake::PinIo io;
+  fake::Timer timer;
+  Stepper::Pins pins[3];
+};
+
+TEST_F(StepperGroupTest, Init) {
+  StepperGroup group(&io, pins, 3, &timer);
+  EXPECT_EQ(3u, group.size());
+  EXPECT_FALSE(io.get(pins[0].enable));
+  for (int axis = 0; axis < 3; axis++) {
+    EXPECT_FALSE(io.get(pins[axis].step));
+    EXPECT_TRUE(io.get(pins[axis].dir));
+    EXPECT_EQ(Stepper::State::DISABLED, group.state(axis));
+  }
+  EXPECT_EQ(7, group.directions());
+}
+
+TEST_F(StepperGroupTest, StepWithOneWritePerPort) {
+  StepperGroup group(&io, pins, 3, &timer);
+  group.step(7);
+  EXPECT_FALSE(io.get(pins[0].step));
+
+  group.enable();
+  EXPECT_TRUE(io.get(pins[0].enable));
+  io.clear_mask_writes();
+  group.step(5);
+  ASSERT_EQ(1u, io.mask_writes().size());
+  EXPECT_TRUE(io.get(pins[0].step));
+  EXPECT_FALSE(io.get(pins[1].step));
+  EXPECT_TRUE(io.get(pins[2].step));
+  EXPECT_EQ(Stepper::State::STEPPING, group.state(0));
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(1));
+
+  // Stepping axes do not step again before unstep
+  group.step(7);
+  EXPECT_EQ(1, group.position(0));
+  EXPECT_EQ(1, group.position(1));
+
+  io.clear_mask_writes();
+  group.unstep();
+  ASSERT_EQ(1u, io.mask_writes().size());
+  for (int axis = 0; axis < 3; axis++) {
+    EXPECT_FALSE(io.get(pins[axis].step));
+    EXPECT_EQ(Stepper::State::ACTIVE, group.state(axis));
+  }
+  EXPECT_EQ(1, group.position(0));
+  EXPECT_EQ(1, group.position(1));
+  EXPECT_EQ(1, group.position(2));
+}
+
+TEST_F(StepperGroupTest, DirectionsTouchOnlyChangedPins) {
+  StepperGroup group(&io, pins, 3, &timer, 5);
+  group.enable();
+  group.set_position(1, 10);
+
+  io.clear_mask_writes();
+  EXPECT_EQ(0u, group.set_directions(7));
+  EXPECT_TRUE(io.mask_writes().empty());
+
+  EXPECT_EQ(5u, group.set_directions(5));
+  ASSERT_EQ(1u, io.mask_writes().size());
+  EXPECT_EQ(PinIo::bit(pins[1].dir), io.mask_writes()[0].mask);
+  EXPECT_EQ(0, io.mask_writes()[0].value);
+  EXPECT_TRUE(io.get(pins[0].dir));
+  EXPECT_FALSE(io.get(pins[1].dir));
+  EXPECT_TRUE(io.get(pins[2].dir));
+
+  // Step waits for the direction setup time
+  timer.wait(2);
+  group.step(7);
+  EXPECT_EQ(5u, timer.timestamp());
+  group.unstep();
+  EXPECT_EQ(1, group.position(0));
+  EXPECT_EQ(9, group.position(1));
+  EXPECT_EQ(1, group.position(2));
+
+  // No wait once the setup time has passed
+  group.set_directions(7);
+  timer.wait(6);
+  group.step(7);
+  EXPECT_EQ(11u, timer.timestamp());
+  group.unstep();
+}
+
+TEST_F(StepperGroupTest, PolledEndstop) {
+  StepperGroup group(&io, pins, 3, &timer);
+  group.enable();
+  group.stop_on_endstop(3);
+
+  io.set(pins[1].endstop);
+  io.set(pins[2].endstop);
+  group.step(7);
+  group.unstep();
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(0));
+  EXPECT_EQ(Stepper::State::STOPPED, group.state(1));
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(2));
+  EXPECT_EQ(2, group.endstop_triggers());
+  EXPECT_EQ(1, group.trigger_position(1));
+
+  group.step(7);
+  group.unstep();
+  EXPECT_EQ(2, group.position(0));
+  EXPECT_EQ(1, group.position(1));
+
+  // Enable restarts stopped axes
+  io.clear(pins[1].endstop);
+  group.enable();
+  group.clear_endstop_triggers(2);
+  group.step(2);
+  group.unstep();
+  EXPECT_EQ(2, group.position(1));
+  EXPECT_EQ(0, group.endstop_triggers());
+}
+
+TEST_F(StepperGroupTest, StopsOnlyTowardsEndstop) {
+  StepperGroup group(&io, pins, 3, &timer);
+  group.enable();
+  group.set_endstop_directions(6);
+  io.set(pins[0].endstop);
+  io.set(pins[1].endstop);
+
+  // Axis 0 has its endstop at the negative end
+  group.step(3);
+  group.unstep();
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(0));
+  EXPECT_EQ(Stepper::State::STOPPED, group.state(1));
+  EXPECT_EQ(2, group.endstop_triggers());
+
+  // Axis 1 moves away from its active endstop, axis 0 towards
+  group.enable();
+  group.set_directions(4);
+  group.step(3);
+  group.unstep();
+  EXPECT_EQ(Stepper::State::STOPPED, group.state(0));
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(1));
+  EXPECT_EQ(3, group.endstop_triggers());
+
+  // Turning towards the endstop rearms its trigger
+  group.enable();
+  io.clear(pins[1].endstop);
+  group.set_directions(6);
+  EXPECT_EQ(1, group.endstop_triggers());
+  group.step(2);
+  group.unstep();
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(1));
+}
+
+TEST_F(StepperGroupTest, EndstopInterrupt) {
+  StepperGroup group(&io, pins, 3, &timer);
+  group.enable();
+  group.use_endstop_interrupt(1);
+
+  // Pin of interrupt axis is not polled
+  io.set(pins[0].endstop);
+  group.step(1);
+  group.unstep();
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(0));
+
+  group.step(1);
+  group.on_endstop(0);
+  EXPECT_EQ(1, group.endstop_triggers());
+  EXPECT_EQ(2, group.trigger_position(0));
+  group.unstep();
+  EXPECT_EQ(Stepper::State::STOPPED, group.state(0));
+  EXPECT_FALSE(io.get(pins[0].step));
+
+  group.on_endstop(2);
+  EXPECT_EQ(Stepper::State::STOPPED, group.state(2));
+  EXPECT_EQ(5, group.endstop_triggers());
+}
+
+TEST_F(StepperGroupTest, EndstopInterruptArmedWhileActive) {
+  StepperGroup group(&io, pins, 3, &timer);
+  group.enable();
+  group.set_position(1, 7);
+
+  // Active endstops give no pin change, they trigger when armed
+  io.set(pins[1].endstop);
+  io.set(pins[2].endstop);
+  group.use_endstop_interrupt(3);
+  EXPECT_EQ(2, group.endstop_triggers());
+  EXPECT_EQ(7, group.trigger_position(1));
+  EXPECT_EQ(Stepper::State::STOPPED, group.state(1));
+
+  // Only cleared interrupt axes are checked
+  group.clear_endstop_triggers(6);
+  EXPECT_EQ(2, group.endstop_triggers());
+  io.clear(pins[1].endstop);
+  group.clear_endstop_triggers(2);
+  EXPECT_EQ(0, group.endstop_triggers());
+}
+
+TEST_F(StepperGroupTest, NoEndstop) {
+  pins[2].endstop = StepperGroup::no_endstop;
+  StepperGroup group(&io, pins, 3, &timer);
+  group.enable();
+  group.stop_on_endstop(7);
+  group.use_endstop_interrupt(6);
+  EXPECT_FALSE(group.is_endstop_active(2));
+
+  // The axis without endstop keeps stepping, its pin is never read
+  for (int step = 0; step < 3; step++) {
+    group.step(7);
+    group.unstep();
+  }
+  EXPECT_EQ(Stepper::State::ACTIVE, group.state(2));
+  EXPECT_EQ(3, group.position(2));
+  EXPECT_EQ(0, group.endstop_triggers());
+}
+
+TEST_F(StepperGroupTest, Disable) {
+  StepperGroup group(&io, pins, 3, &timer);
+  group.enable();
+  group.disable();
+  EXPECT_FALSE(io.get(pins[0].enable));
+  group.step(7);
+  EXPECT_EQ(0, group.position(0));
+  EXPECT_EQ(Stepper::State::DISABLED, group.state(0));
+}
+
+TEST_F(StepperGroupTest, TooManyAxes) {
+  Stepper::Pins many[StepperGroup::max_axes + 1];
+  for (auto& axis : many) {
+    axis = pins[0];
+  }
+  EXPECT_DEATH(StepperGroup(&io, many, StepperGroup::max_axes + 1, &timer),
+	       "max_axes");
+}
@@ -1,8 +1,11 @@
 #include <gtest/gtest.h>
+#include <memory>
 
 #include <src/trapezoid_ticker.h>
 #include <src/planner.h>
-#include <src/stepper.h>
+#include <src/stepper_group.h>
+#include <src/move.h>
+#include <src/profile_analysis.h>
 #include <fake/timer.h>
 #include <fake/pin_io.h>
 
@@ -17,25 +20,78 @@ public:
       pins.step = io.make_pin("step" + name, true);
       pins.dir = io.make_pin("dir" + name, true);
       pins.endstop = io.make_pin("endstop" + name);
-      steppers.emplace_back(Stepper(&io, pins));
+      axisPins.push_back(pins);
+      stepPins.push_back(pins.step);
+      dirPins.push_back(pins.dir);
     }
+    group.reset(new StepperGroup(&io, axisPins.data(), axisPins.size(),
+				 &timer));
+    group->enable();
+  }
+
+  void reset_positions() {
+    for (unsigned axis = 0; axis < group->size(); axis++) {
+      group->set_position(axis, 0);
+    }
+  }
+
+  std::vector<int> positions() const {
+    std::vector<int> steps;
+    for (unsigned axis = 0; axis < group->size(); axis++) {
+      steps.push_back(group->position(axis));
+    }
+    return steps;
+  }
 
-    for (auto& stepper : steppers) {
-      stepperPtrs.push_back(&stepper);
-      stepper.enable();
+  /// Check pin edges recorded since io.set_clock() for every stepper.
+  /** Step pulses are high and low at least min_width, DIR only changes
+      while STEP is low and at least min_width before the next step.
+   */
+  void check_edges(std::uint32_t min_width) {
+    EXPECT_FALSE(io.edges().empty());
+    for (unsigned ind = 0; ind < group->size(); ind++) {
+      bool high = false;
+      bool stepped = false;
+      bool turned = false;
+      std::uint32_t step_time = 0;
+      std::uint32_t dir_time = 0;
+      for (const auto& edge : io.edges()) {
+	if (edge.pin_no == stepPins[ind].pin_no) {
+	  if (stepped) {
+	    EXPECT_LE(min_width, edge.time - step_time)
+	      << "stepper " << ind << " at " << edge.time;
+	  }
+	  if (edge.level && turned) {
+	    EXPECT_LE(min_width, edge.time - dir_time)
+	      << "stepper " << ind << " at " << edge.time;
+	    turned = false;
+	  }
+	  high = edge.level;
+	  stepped = true;
+	  step_time = edge.time;
+	}
+	else if (edge.pin_no == dirPins[ind].pin_no) {
+	  EXPECT_FALSE(high) << "stepper " << ind << " at " << edge.time;
+	  turned = true;
+	  dir_time = edge.time;
+	}
+      }
+      EXPECT_FALSE(high) << "stepper " << ind;
     }
   }
 
 protected:
   fake::Timer timer;
   fake::PinIo io;
-  std::vector<Stepper> steppers;
-  std::vector<Stepper*> stepperPtrs;
+  std::vector<Stepper::Pins> axisPins;
+  std::unique_ptr<StepperGroup> group;
+  std::vector<PinIo::Pin> stepPins;
+  std::vector<PinIo::Pin> dirPins;
 };
 
 TEST_F(TrapezoidTest, simple) {
-  TrapezoidTicker ticker(stepperPtrs, &timer);
-  Planner planner(16,steppers.size());
+  TrapezoidTicker ticker(group.get(), &timer);
+  Planner planner(16,group->size());
 
   std::vector<int> steps{1,2,-3,10};
   std::vector<int> steps2{-2,-3,2,-9};
@@ -50,7 +106,7 @@ TEST_F(TrapezoidTest, simple) {
   while((delay = timer.fake_next())) {
     for (unsigned ind = 0; ind < steps.size(); ind++) {
       if (ind > 0) std::cout << ", ";
-      std::cout << steppers[ind].position();
+      std::cout << group->position(ind);
     }
     time += delay;
     std::cout << std::endl << delay << ": ";
@@ -58,6 +114,382 @@ TEST_F(TrapezoidTest, simple) {
   std::cout << std::endl;
 
   for (unsigned ind = 0; ind < steps.size(); ind++) {
-    EXPECT_EQ(steps[ind]+steps2[ind], steppers[ind].position());
+    EXPECT_EQ(steps[ind]+steps2[ind], group->position(ind));
+  }
+}
+
+namespace {
+  struct RunResult {
+    std::vector<int> positions;
+    std::uint32_t time;
+    unsigned interrupts;
+  };
+}
+
+TEST_F(TrapezoidTest, multi_step) {
+  std::vector<int> steps{100, 200, -300, 1000};
+  std::vector<int> steps2{-200, -300, 200, -900};
+  const std::uint32_t pulse_width = 2e-6f * timer.frequency();
+  const std::uint32_t max_burst = 30e-6f * timer.frequency();
+  io.set_clock(&timer);
+
+  auto run = [&](float multi_step_rate) {
+    reset_positions();
+    io.clear_edges();
+    TrapezoidTicker ticker(group.get(), &timer);
+    ticker.set_multi_step_rate(multi_step_rate);
+    Planner planner(16, group->size());
+    planner.plan_move(steps, 1, 10, 100, 1);
+    planner.plan_move(steps2, 1, 20, 100, 1);
+    ticker.start(&planner);
+
+    RunResult result{{}, 0, 0};
+    timer.reset_busy();
+    while (std::uint32_t delay = timer.fake_next()) {
+      result.time += delay;
+      result.interrupts++;
+    }
+    result.positions = positions();
+    check_edges(pulse_width);
+    // Busy waits of one interrupt end within a pulse after max_burst
+    EXPECT_LE(timer.max_busy(), max_burst + pulse_width);
+    return result;
+  };
+
+  RunResult single = run(0);
+  RunResult multi = run(300);
+
+  EXPECT_EQ(single.positions, multi.positions);
+  EXPECT_EQ(single.time, multi.time);
+  EXPECT_LT(multi.interrupts, single.interrupts/2);
+
+  // Threshold above event rate has no effect
+  RunResult high = run(1e5f);
+  EXPECT_EQ(single.interrupts, high.interrupts);
+}
+
+TEST_F(TrapezoidTest, merged_pulses) {
+  std::vector<int> steps{10, 20, -30, 100};
+  std::vector<int> steps2{-20, -30, 20, -45};
+  const std::uint32_t pulse_width = 2e-6f * timer.frequency();
+  io.set_clock(&timer);
+
+  auto run = [&](TrapezoidTicker::PulseMode mode) {
+    reset_positions();
+    TrapezoidTicker ticker(group.get(), &timer);
+    ticker.set_pulse_mode(mode);
+    ticker.set_multi_step_rate(500);
+    io.clear_edges();
+    Planner planner(16, group->size());
+    planner.plan_move(steps, 1, 10, 100, 1);
+    planner.plan_move(steps2, 1, 20, 100, 1);
+    ticker.start(&planner);
+
+    RunResult result{{}, 0, 0};
+    while (std::uint32_t delay = timer.fake_next()) {
+      result.time += delay;
+      result.interrupts++;
+    }
+    result.positions = positions();
+    check_edges(pulse_width);
+    return result;
+  };
+
+  RunResult split = run(TrapezoidTicker::PulseMode::SPLIT);
+  RunResult merged = run(TrapezoidTicker::PulseMode::MERGED);
+
+  EXPECT_EQ(split.positions, merged.positions);
+  for (unsigned ind = 0; ind < steps.size(); ind++) {
+    EXPECT_EQ(steps[ind]+steps2[ind], merged.positions[ind]);
+  }
+  EXPECT_LT(merged.interrupts, split.interrupts*3/4);
+}
+
+TEST_F(TrapezoidTest, merged_pulse_busy_wait) {
+  std::vector<int> steps{0, 0, 0, 1000};
+  const std::uint32_t pulse_width = 2e-6f * timer.frequency();
+  io.set_clock(&timer);
+
+  TrapezoidTicker ticker(group.get(), &timer);
+  ticker.set_pulse_mode(TrapezoidTicker::PulseMode::MERGED);
+  Planner planner(16, group->size());
+  planner.plan_move(steps, 10, 20, 1000, 0);
+  ticker.start(&planner);
+
+  unsigned interrupts = 0;
+  timer.reset_busy();
+  while (timer.fake_next()) {
+    interrupts++;
+  }
+  EXPECT_EQ(1000, group->position(3));
+  check_edges(pulse_width);
+
+  // One interrupt per step and one for the direction setup. The fake
+  // timer takes no time for the ramp and Bresenham work between
+  // release and step, so every step after the first busy waits the
+  // full low time. On the target that work is longer than the low time.
+  EXPECT_EQ(1000u + 1, interrupts);
+  EXPECT_EQ(999*pulse_width, timer.busy());
+  EXPECT_EQ(pulse_width, timer.max_busy());
+}
+
+TEST_F(TrapezoidTest, dominant_axis) {
+  // More steps than the old fixed rate had events
+  std::vector<int> steps{5, 1000, -3, 0};
+  std::vector<int> none{0, 0, 0, 0};
+  std::vector<int> steps2{-5, -100, 3, 1};
+
+  TrapezoidTicker ticker(group.get(), &timer);
+  Planner planner(16, group->size());
+  planner.plan_move(steps, 1, 10, 1000, 1);
+  planner.plan_move(none, 1, 10, 1000, 1);
+  planner.plan_move(steps2, 1, 10, 1000, 1);
+
+  Move move{steps, 1, 10, 1000};
+  EXPECT_EQ(1000u, TrapezoidTicker::make_profile(move, 0, 0, 1e6f).events);
+  EXPECT_EQ(0u, TrapezoidTicker::make_profile(Move{none, 1, 10, 1000},
+					      0, 0, 1e6f).events);
+
+  ticker.start(&planner);
+  unsigned interrupts = 0;
+  while (timer.fake_next()) {
+    interrupts++;
+  }
+
+  // Step and unstep interrupt per event, and direction setup at start
+  EXPECT_EQ(2*1100u + 1, interrupts);
+  for (unsigned ind = 0; ind < steps.size(); ind++) {
+    EXPECT_EQ(steps[ind]+steps2[ind], group->position(ind));
+  }
+}
+
+TEST_F(TrapezoidTest, smoothing_level) {
+  Move move{{10, -20, 5, 0}, 1, 10, 100};
+
+  // Fastest axis 200 steps/s, 1.75 axis steps per step of it. Level 1
+  // takes 2 events and 1.75 unsteps per step, 750 interrupts/s.
+  EXPECT_EQ(0u, TrapezoidTicker::make_profile(move, 0, 0, 1e6f).level);
+  EXPECT_EQ(0u, TrapezoidTicker::make_profile(move, 0, 0, 1e6f, 700).level);
+  EXPECT_EQ(1u, TrapezoidTicker::make_profile(move, 0, 0, 1e6f, 750).level);
+  EXPECT_EQ(1u, TrapezoidTicker::make_profile(move, 0, 0, 1e6f, 1e3f).level);
+  EXPECT_EQ(2u, TrapezoidTicker::make_profile(move, 0, 0, 1e6f, 1150).level);
+
+  // No unstep interrupts when pulses are merged
+  EXPECT_EQ(1u, TrapezoidTicker::make_profile(
+	      move, 0, 0, 1e6f, 400,
+	      TrapezoidTicker::PulseMode::MERGED).level);
+
+  TrapezoidTicker::Profile profile =
+    TrapezoidTicker::make_profile(move, 0, 0, 1e6f, 1e5f);
+  EXPECT_EQ(TrapezoidTicker::max_level, profile.level);
+  EXPECT_EQ(20u << TrapezoidTicker::max_level, profile.events);
+
+  // Fast axis limits oversampling
+  Move fast{{10, -3000, 5, 0}, 1, 10, 100};
+  EXPECT_EQ(1u, TrapezoidTicker::make_profile(fast, 0, 0, 1e6f, 1e5f).level);
+}
+
+TEST_F(TrapezoidTest, smoothing) {
+  std::vector<int> steps{7, 1000, 0, -3};
+
+  auto run = [&](float max_interrupt_rate,
+		 std::vector<std::uint32_t>& times) {
+    reset_positions();
+    TrapezoidTicker ticker(group.get(), &timer);
+    ticker.set_max_interrupt_rate(max_interrupt_rate);
+    Planner planner(16, group->size());
+    planner.plan_move(steps, 10, 10, 1e4f, 1);
+    ticker.start(&planner);
+
+    RunResult result{{}, 0, 0};
+    int last = 0;
+    std::uint32_t delay;
+    do {
+      delay = timer.fake_next();
+      result.interrupts++;
+      if (group->position(0) != last) {
+	last = group->position(0);
+	times.push_back(result.time);
+      }
+      result.time += delay;
+    } while (delay);
+
+    result.positions = positions();
+    return result;
+  };
+
+  // Spread of step intervals of slow axis
+  auto spread = [](const std::vector<std::uint32_t>& times) {
+    std::uint32_t min = ~0u, max = 0;
+    for (unsigned ind = 1; ind < times.size(); ind++) {
+      std::uint32_t interval = times[ind] - times[ind-1];
+      min = std::min(min, interval);
+      max = std::max(max, interval);
+    }
+    return max - min;
+  };
+
+  std::vector<std::uint32_t> plain_times, smooth_times;
+  RunResult plain = run(0, plain_times);
+  RunResult smooth = run(1e4f, smooth_times);
+
+  EXPECT_EQ(steps, plain.positions);
+  EXPECT_EQ(steps, smooth.positions);
+  EXPECT_EQ(7u, smooth_times.size());
+  EXPECT_LT(2*spread(smooth_times), spread(plain_times));
+
+  // Level 3, 8000 events and one unstep per event with steps, of
+  // which there are at most 1010, then the stop
+  EXPECT_LT(8000u, smooth.interrupts);
+  EXPECT_GE(8000u + 1010 + 1, smooth.interrupts);
+  EXPECT_GE(1e4f, smooth.interrupts / (smooth.time / timer.frequency()));
+}
+
+TEST_F(TrapezoidTest, continuous_junctions) {
+  // Same axis and steps per mm in all moves, junctions at speed
+  std::vector<int> steps{0, 0, 0, 400};
+  const float speeds[] = {50, 30, 30, 40};
+
+  auto run = [&](TrapezoidTicker::PulseMode mode) {
+    group->set_position(3, 0);
+    TrapezoidTicker ticker(group.get(), &timer);
+    ticker.set_pulse_mode(mode);
+    Planner planner(16, group->size());
+    for (float speed : speeds) {
+      planner.plan_move(steps, 5, speed, 1000, speed);
+    }
+    ticker.start(&planner);
+
+    std::vector<std::uint32_t> times;
+    std::uint32_t time = 0;
+    int last = 0;
+    std::uint32_t delay;
+    do {
+      delay = timer.fake_next();
+      if (group->position(3) != last) {
+	last = group->position(3);
+	times.push_back(time);
+      }
+      time += delay;
+    } while (delay);
+    return times;
+  };
+
+  for (auto mode : {TrapezoidTicker::PulseMode::SPLIT,
+		    TrapezoidTicker::PulseMode::MERGED}) {
+    std::vector<std::uint32_t> times = run(mode);
+    ASSERT_EQ(4*400u, times.size());
+
+    // Around the junctions after step 400, 800 and 1200, neighbouring
+    // intervals differ no more than ramp steps do.
+    for (unsigned junction = 400; junction < times.size(); junction += 400) {
+      for (unsigned ind = junction - 20; ind < junction + 20; ind++) {
+	float interval = times[ind] - times[ind-1];
+	float previous = times[ind-1] - times[ind-2];
+	EXPECT_NEAR(previous, interval, 0.03f*previous) << ind;
+      }
+    }
+
+    // Cruise at 30 mm/s, 80 steps/mm, on both sides of a junction.
+    // Cruise delays are rounded, the first delay of a move adjusted.
+    EXPECT_NEAR(10*1e6f/(30*80), times[805] - times[795], 10*0.5f + 1);
+  }
+}
+
+TEST_F(TrapezoidTest, latency_does_not_accumulate) {
+  std::vector<int> steps{10, 20, -30, 100};
+  std::vector<int> steps2{-20, -30, 20, -45};
+
+  auto run = [&](std::uint32_t latency,
+		 TrapezoidTicker::Lateness& lateness,
+		 float multi_step_rate = 0) {
+    reset_positions();
+    timer.set_latency(latency);
+    TrapezoidTicker ticker(group.get(), &timer);
+    ticker.set_multi_step_rate(multi_step_rate);
+    Planner planner(16, group->size());
+    planner.plan_move(steps, 1, 10, 100, 1);
+    planner.plan_move(steps2, 1, 20, 100, 1);
+    std::uint32_t start = timer.timestamp();
+    ticker.start(&planner);
+
+    std::vector<std::uint32_t> times;
+    int last = 0;
+    while (timer.fake_next()) {
+      if (group->position(3) != last) {
+	last = group->position(3);
+	times.push_back(timer.timestamp() - start);
+      }
+    }
+    for (unsigned ind = 0; ind < steps.size(); ind++) {
+      EXPECT_EQ(steps[ind]+steps2[ind], group->position(ind));
+    }
+    lateness = ticker.lateness();
+    return times;
+  };
+
+  TrapezoidTicker::Lateness ideal_lateness, late_lateness;
+  std::vector<std::uint32_t> ideal = run(0, ideal_lateness);
+  std::vector<std::uint32_t> late = run(3, late_lateness);
+
+  EXPECT_EQ(0u, ideal_lateness.late);
+  EXPECT_EQ(0u, ideal_lateness.max);
+  EXPECT_LT(0u, late_lateness.late);
+  // Only the timer latency counts
+  EXPECT_EQ(3u, late_lateness.max);
+  EXPECT_EQ(0u, late_lateness.missed);
+
+  // Busy waits and moved events of multi stepping are not lateness
+  TrapezoidTicker::Lateness multi_lateness;
+  run(0, multi_lateness, 300);
+  EXPECT_EQ(0u, multi_lateness.late);
+  EXPECT_EQ(0u, multi_lateness.missed);
+  EXPECT_EQ(0u, multi_lateness.max);
+
+  // Every later step is late by the latency only
+  ASSERT_EQ(ideal.size(), late.size());
+  EXPECT_EQ(ideal[0] + 2*3, late[0]);
+  for (unsigned ind = 1; ind < ideal.size(); ind++) {
+    EXPECT_EQ(ideal[ind] + 3, late[ind]) << ind;
+  }
+}
+
+TEST_F(TrapezoidTest, exact_generator) {
+  std::vector<int> steps{20, -50, 0, 200};
+  Move move{steps, 2, 50, 500};
+  TrapezoidTicker::Profile profile =
+    TrapezoidTicker::make_profile(move, 0, 0, timer.frequency());
+  std::vector<double> times;
+  ProfileAnalyzer::exact_times(ProfileSpec{profile.events, profile.entry_rate,
+					   profile.exit_rate,
+					   profile.nominal_rate,
+					   profile.acceleration},
+			       timer.frequency(), times);
+
+  TrapezoidTicker ticker(group.get(), &timer);
+  ticker.set_generator(TrapezoidTicker::Generator::EXACT);
+  Planner planner(16, group->size());
+  planner.plan_move(steps, move.length, move.speed, move.acceleration, 0);
+  ticker.start(&planner);
+
+  // Every step of the dominant axis is at its exact event time,
+  // counted from the first step
+  unsigned event = 0;
+  int last = 0;
+  std::uint32_t first = 0;
+  while (timer.fake_next()) {
+    if (group->position(3) != last) {
+      last = group->position(3);
+      if (event == 0) {
+	first = timer.timestamp();
+      }
+      ASSERT_LT(event, times.size());
+      EXPECT_NEAR(times[event], timer.timestamp() - first, 0.5) << event;
+      event++;
+    }
+  }
+  EXPECT_EQ(profile.events, event);
+  for (unsigned ind = 0; ind < steps.size(); ind++) {
+    EXPECT_EQ(steps[ind], group->position(ind));
   }
 }
@@ -1,8 +1,11 @@
 #include <gtest/gtest.h>
 #include <cmath>
 #include <vector>
+#include <cstdlib>
 
 #include <src/trapezoid_generator.h>
+#include <src/exact_trapezoid_generator.h>
+#include <src/profile_analysis.h>
 
 namespace {
   const uint32_t reference[] = {1000, 600, 467, 395, 349, 316, 291, 271, 254, 241, 229};
@@ -46,6 +49,46 @@ TEST(Ramp, verify_with_reference_data) {
   }
 }
 
+TEST(Ramp, same_as_division) {
+  // Ramp::nextDelay() as it was with / and %
+  struct DivisionRamp {
+    std::int32_t c, n, remainder;
+    std::uint32_t nextDelay() {
+      n += 1;
+      std::int32_t nom = 2*c + remainder;
+      std::int32_t den = 4*n + 1;
+      remainder = nom % den;
+      c -= nom / den;
+      if (den < 0 && remainder > 0) {
+	c += 1;
+	remainder += den;
+      }
+      return c;
+    }
+    void reverseAcc() {
+      n = -n - 1;
+      remainder = -remainder;
+    }
+  };
+
+  std::srand(5);
+  for (unsigned test = 0; test < 2000; test++) {
+    std::uint32_t c0 = 1 + std::rand() % 1000000;
+    std::int32_t n0 = std::rand() % 3 ? 0 : std::rand() % 100000;
+    std::uint32_t acc_steps = std::rand() % 3000;
+    Ramp ramp(c0, n0);
+    DivisionRamp reference{std::int32_t(c0), n0, 0};
+    for (std::uint32_t step = 0; step < 2*acc_steps; step++) {
+      if (step == acc_steps) {
+	ramp.reverseAcc();
+	reference.reverseAcc();
+      }
+      ASSERT_EQ(reference.nextDelay(), ramp.nextDelay())
+	<< c0 << " " << n0 << " " << step;
+    }
+  }
+}
+
 TEST(TrapezoidGenerator, constant_speed) {
   const uint32_t steps = 10;
   const float v = 100;
@@ -180,3 +223,200 @@ TEST(TrapezoidGenerator, start_to_running_with_cruising) {
 
   testTrapezoid(p, makeVec(ref));  
 }
+
+TEST(TrapezoidParameters, carry_fraction) {
+  // Cruise only, exact delay is 1e6/3 = 333333.33 ticks
+  const float f = 1e6f;
+  const std::uint32_t steps = 10;
+  std::int16_t residue = 0;
+  std::int64_t total = 0;
+  double exact_first = 0;
+  for (unsigned move = 0; move < 30; move++) {
+    TrapezoidParameters p(steps, 3, 3, 3, f, 1);
+    EXPECT_EQ(333333, p.c0);
+    p.carry_fraction(residue);
+
+    TrapezoidGenerator g(p);
+    EXPECT_EQ(p.c0 + p.first_adjust, g.peek_delay());
+    std::int64_t time = 0;
+    while (!g.is_done()) {
+      time += g.next_delay();
+    }
+    // Only the first delay is adjusted, the move time by one tick
+    EXPECT_NEAR(steps*p.c0, time, 1) << move;
+    total += time;
+    exact_first += p.c0 + p.c0_fraction/256.0;
+  }
+  // Rounding errors of the first delays do not add up
+  EXPECT_NEAR(30*(steps-1)*333333 + exact_first, total, 1);
+}
+
+TEST(ExactTrapezoidGenerator, constant_speed) {
+  // 1e4/300 = 33.33 ticks per step
+  ExactTrapezoidGenerator g(30, 300, 300, 300, 1e4f, 1000);
+  std::uint32_t sum = 0;
+  for (unsigned step = 0; step < 30; step++) {
+    std::uint32_t delay = g.next_delay();
+    EXPECT_NEAR(33.33, delay, 1);
+    sum += delay;
+  }
+  EXPECT_TRUE(g.is_done());
+  EXPECT_EQ(0u, g.next_delay());
+  EXPECT_EQ(1000u, sum);
+}
+
+TEST(ExactTrapezoidGenerator, symmetric_ramps) {
+  const std::uint32_t steps = 200;
+  ExactTrapezoidGenerator g(steps, 0, 0, 5000, 1e6f, 1e5f);
+  std::vector<std::uint32_t> delays;
+  while (!g.is_done()) {
+    delays.push_back(g.next_delay());
+  }
+  ASSERT_EQ(steps, delays.size());
+  // First delay is the exact sqrt(2/a), no correction factor
+  EXPECT_NEAR(1e6*std::sqrt(2/1e5), delays[0], 1);
+  for (unsigned ind = 0; ind < steps; ind++) {
+    EXPECT_NEAR(delays[ind], delays[steps - 1 - ind], 1) << ind;
+  }
+}
+
+TEST(ExactTrapezoidGenerator, cumulative_error_below_one_tick) {
+  // Rates m*2^p with 2p > log2(acc) put both ramp ends at whole steps,
+  // where the analytic trapezoid and the generator's ramps coincide:
+  // v^2/(2*acc) is exact in float.
+  std::srand(4);
+  const float frequencies[] = {250000, 1e6f, 2e6f};
+  for (unsigned test = 0; test < 300; test++) {
+    double f = frequencies[test % 3];
+    int acc_exp = 13 + std::rand() % 8;
+    double acc = std::ldexp(1, acc_exp);
+    int rate_exp = acc_exp/2 + 1;
+    double nominal = std::ldexp(1 + std::rand() % 48, rate_exp);
+    double entry = std::rand() % 2 ? 0 :
+      std::ldexp(std::rand() % int(std::ldexp(nominal, -rate_exp)),
+		 rate_exp);
+    double exit = std::rand() % 2 ? 0 :
+      std::ldexp(std::rand() % int(std::ldexp(nominal, -rate_exp)),
+		 rate_exp);
+    double acc_steps = (nominal*nominal - entry*entry)/(2*acc);
+    double dec_steps = (nominal*nominal - exit*exit)/(2*acc);
+    std::uint32_t steps = acc_steps + dec_steps + std::rand() % 5000;
+    if (steps == 0) {
+      continue;
+    }
+    double dec_start = steps - dec_steps;
+
+    // Analytic event times in ticks
+    auto ideal = [&](double s) {
+      if (s <= acc_steps) {
+	return f*(std::sqrt(entry*entry + 2*acc*s) - entry)/acc;
+      }
+      double t = f*(nominal - entry)/acc;
+      if (s <= dec_start) {
+	return t + f*(s - acc_steps)/nominal;
+      }
+      t += f*(dec_start - acc_steps)/nominal;
+      return t + f*(nominal -
+		    std::sqrt(nominal*nominal - 2*acc*(s - dec_start)))/acc;
+    };
+
+    ExactTrapezoidGenerator g(steps, entry, exit, nominal, f, acc);
+    std::uint64_t time = 0;
+    for (std::uint32_t event = 1; event <= steps; event++) {
+      ASSERT_FALSE(g.is_done());
+      time += g.next_delay();
+      // Half a tick from rounding, and a little from the integer roots
+      ASSERT_NEAR(ideal(event), time, 0.55) << test << " " << event;
+    }
+    EXPECT_TRUE(g.is_done());
+    ProfileSpec spec{steps, float(entry), float(exit), float(nominal),
+		     float(acc)};
+    EXPECT_NEAR(ProfileAnalyzer::ideal_time(spec)*f, time, 0.55) << test;
+  }
+}
+
+TEST(TrapezoidGenerator, slow_cruise_without_ramp) {
+  // Nominal speed is reached within the first step
+  const float f = 1e6f;
+  const float v = 600;
+  TrapezoidParameters p(100, 0, 0, v, f, 1e6f);
+  EXPECT_EQ(0u, p.accelerateUntil);
+  EXPECT_EQ(100u, p.decelerateAfter);
+
+  std::vector<uint32_t> ref(100, std::round(f/v));
+  testTrapezoid(p, ref);
+}
+
+TEST(TrapezoidGenerator, ramp_overshoot_clamped_to_nominal) {
+  // Nominal rate is reached after one step, where the first ramp step
+  // overshoots it: 1e6/854 = 1171 ticks, the ramp gives 974
+  const float f = 1e6f;
+  TrapezoidParameters p(20, 0, 0, 854, f, 347242);
+  EXPECT_EQ(1171u, p.c_nominal);
+
+  TrapezoidGenerator g(p);
+  std::vector<std::uint32_t> delays;
+  while (!g.is_done()) {
+    delays.push_back(g.next_delay());
+  }
+  ASSERT_EQ(20u, delays.size());
+  EXPECT_EQ(1622u, delays[0]);
+  for (unsigned ind = 1; ind < delays.size(); ind++) {
+    EXPECT_EQ(1171u, delays[ind]) << ind;
+  }
+}
+
+TEST(TrapezoidParameters, from_fixed_matches_float) {
+  std::srand(3);
+  const std::uint32_t frequencies[] = {250000, 1000000, 2000000, 16000000};
+  for (unsigned test = 0; test < 20000; test++) {
+    std::uint32_t f = frequencies[test % 4];
+    // Rates up to 100k steps/s, accelerations 1k-1M steps/s^2, in Q24.8
+    std::uint32_t nominal = 256 + std::rand() % (100000*256);
+    std::uint32_t entry = std::rand() % 3 ? 0 : std::rand() % nominal;
+    std::uint32_t exit = std::rand() % 3 ? 0 : std::rand() % nominal;
+    std::uint32_t acc = 1000*256 + std::rand() % (999000*256);
+    std::uint32_t steps = 1 + std::rand() % 100000;
+
+    TrapezoidParameters fixed =
+      TrapezoidParameters::from_fixed(steps, entry, exit, nominal, f, acc);
+    TrapezoidParameters reference(steps, entry/256.0f, exit/256.0f,
+				  nominal/256.0f, f, acc/256.0f);
+
+    SCOPED_TRACE(::testing::Message() << steps << " " << entry << " "
+		 << exit << " " << nominal << " " << f << " " << acc);
+    ASSERT_EQ(reference.steps, fixed.steps);
+    ASSERT_NEAR(reference.n0, fixed.n0, 1);
+    ASSERT_NEAR(reference.c0, fixed.c0, 1);
+    ASSERT_NEAR(reference.c_nominal, fixed.c_nominal, 1);
+    ASSERT_NEAR(reference.accelerateUntil, fixed.accelerateUntil, 1);
+    ASSERT_NEAR(reference.decelerateAfter, fixed.decelerateAfter, 1);
+    ASSERT_NEAR(reference.c0*256 + reference.c0_fraction,
+		fixed.c0*256 + fixed.c0_fraction, 256);
+  }
+}
+
+TEST(TrapezoidParameters, from_fixed_exact_values) {
+  // 1000 steps/s, 2000 steps/s^2: 250 steps to nominal
+  TrapezoidParameters p =
+    TrapezoidParameters::from_fixed(1000, 0, 0, 1000*256, 1000000, 2000*256);
+  EXPECT_EQ(0, p.n0);
+  EXPECT_EQ(250u, p.accelerateUntil);
+  EXPECT_EQ(750u, p.decelerateAfter);
+  // 0.676*1e6*sqrt(2/2000) = 21377.36
+  EXPECT_EQ(21377, p.c0);
+  EXPECT_EQ(1000u, p.c_nominal);
+
+  p = TrapezoidParameters::from_fixed(1000, 3*256, 3*256, 3*256, 1000000,
+				      256);
+  // 1e6/3 = 333333.33
+  EXPECT_EQ(4, p.n0);
+  EXPECT_EQ(333333, p.c0);
+  EXPECT_EQ(85, p.c0_fraction);
+
+  // Start clamped to the nominal delay, as the float constructor
+  p = TrapezoidParameters::from_fixed(20, 0, 0, 854*256, 1000000,
+				      347242*256);
+  EXPECT_EQ(1622, p.c0);
+  EXPECT_EQ(1171u, p.c_nominal);
+}
@@ -0,0 +1,87 @@
+/// Compile G-code into a binary move stream for MoveDecoder.
+/**
+   Runs the same GcodeParser and DeltaGantry segmentation as the
+   firmware, but on the host, and writes the resulting linear moves
+   to stdout as records described in move_protocol.h.
+
+   Usage: gcode2bin [radius arm_length steps_per_mm e_steps_per_mm] < in.gcode > out.bin
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "src/delta_gantry.h"
+#include "src/gcode_parser.h"
+#include "src/move_encoder.h"
+
+int main(int argc, char *argv[])
+{
+  float radius = 100;
+  float arm_length = 215;
+  float steps_per_mm = 80;
+  float e_steps_per_mm = 100;
+
+  if (argc == 5) {
+    radius = std::atof(argv[1]);
+    arm_length = std::atof(argv[2]);
+    steps_per_mm = std::atof(argv[3]);
+    e_steps_per_mm = std::atof(argv[4]);
+  }
+  else if (argc != 1) {
+    std::fprintf(stderr, "Usage: %s [radius arm_length steps_per_mm "
+		 "e_steps_per_mm] < in.gcode > out.bin\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<DeltaGantry::Axis> axes(3, DeltaGantry::Axis{
+      steps_per_mm, 1/(steps_per_mm*300), 1/(steps_per_mm*3000)});
+  axes.push_back(DeltaGantry::Axis{
+      e_steps_per_mm, 1/(e_steps_per_mm*50), 1/(e_steps_per_mm*1000)});
+
+  std::vector<DeltaGantry::Tower> towers;
+  const float pi = 3.14159265f;
+  for (unsigned tower = 0; tower < 3; ++tower) {
+    float angle = pi/2 + tower*2*pi/3;
+    towers.push_back(DeltaGantry::Tower{
+	{radius*cosf(angle), radius*sinf(angle), 0}, arm_length});
+  }
+
+  DeltaGantry gantry(axes, towers);
+  GcodeParser parser(&gantry);
+  MoveEncoder encoder(axes.size());
+
+  std::vector<Gantry::LinearMove> moves(64);
+  for (auto& move : moves) {
+    move.steps.resize(axes.size());
+  }
+
+  std::vector<uint8_t> out;
+  encoder.header(out);
+
+  unsigned long records = 0;
+  int c;
+  while ((c = std::getchar()) != EOF) {
+    if (!parser.consume(c)) {
+      continue;
+    }
+
+    unsigned count;
+    while ((count = gantry.get_moves(&moves[0], moves.size())) > 0) {
+      for (unsigned ind = 0; ind < count; ++ind) {
+	encoder.encode(moves[ind], out);
+      }
+      records += count;
+      std::fwrite(out.data(), 1, out.size(), stdout);
+      out.clear();
+    }
+  }
+  std::fwrite(out.data(), 1, out.size(), stdout);
+
+  std::fprintf(stderr, "%lu lines, %lu errors, %lu moves\n",
+	       static_cast<unsigned long>(parser.lines()),
+	       static_cast<unsigned long>(parser.errors()),
+	       records);
+  return 0;
+}
@@ -0,0 +1,121 @@
+/// Linux stand-in for the firmware serial input path.
+/**
+   Creates a pseudo terminal and behaves like the device end of the
+   serial link: bytes are pushed to a RingBuffer of the same size as
+   on the target, as the receive interrupt would, and the main loop
+   feeds them through GcodeParser into a DeltaGantry, reporting
+   consumed bytes with flow_control::Device.
+
+   The slave path is printed on startup, connect stream_host to it.
+   Bytes lost to a full receive buffer are reported on exit (Ctrl-C).
+
+   Usage: pty_device [bytes_per_ms]
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#include "src/delta_gantry.h"
+#include "src/flow_control.h"
+#include "src/gcode_parser.h"
+#include "src/ring_buffer.h"
+
+namespace {
+  volatile std::sig_atomic_t done = 0;
+
+  void on_signal(int) {
+    done = 1;
+  }
+
+  DeltaGantry make_gantry() {
+    std::vector<DeltaGantry::Axis> axes(4, DeltaGantry::Axis{80, 1e-5, 1e-6});
+    std::vector<DeltaGantry::Tower> towers;
+    const float pi = 3.14159265f;
+    for (unsigned tower = 0; tower < 3; ++tower) {
+      float angle = pi/2 + tower*2*pi/3;
+      towers.push_back(DeltaGantry::Tower{
+	  {100*cosf(angle), 100*sinf(angle), 0}, 215});
+    }
+    return DeltaGantry(axes, towers);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  // Limits consumption rate to emulate a busy main loop
+  unsigned bytes_per_ms = argc > 1 ? std::atoi(argv[1]) : 25;
+
+  int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+    std::perror("pty");
+    return 1;
+  }
+
+  struct termios tio;
+  tcgetattr(fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(fd, TCSANOW, &tio);
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+
+  std::printf("%s\n", ptsname(fd));
+  std::fflush(stdout);
+  std::signal(SIGINT, on_signal);
+
+  typedef RingBuffer<128> RxBuffer;
+  RxBuffer rx;
+  unsigned long overruns = 0;
+
+  DeltaGantry gantry = make_gantry();
+  GcodeParser parser(&gantry);
+  flow_control::Device flow(RxBuffer::capacity()/4);
+  Gantry::LinearMove moves[16];
+  for (auto& move : moves) {
+    move.steps.resize(4);
+  }
+  unsigned long segments = 0;
+
+  while (!done) {
+    // Receive interrupt
+    uint8_t data[64];
+    ssize_t count = read(fd, data, sizeof(data));
+    for (ssize_t ind = 0; ind < count; ind++) {
+      if (!rx.push(data[ind])) {
+	overruns++;
+      }
+    }
+
+    // Main loop
+    uint8_t byte;
+    for (unsigned ind = 0; ind < bytes_per_ms && rx.pop(byte); ind++) {
+      flow.consumed();
+      if (parser.consume(byte)) {
+	unsigned moved;
+	while ((moved = gantry.get_moves(moves, 16)) > 0) {
+	  segments += moved;
+	}
+      }
+    }
+
+    uint8_t message[flow_control::max_message];
+    uint8_t length = flow.take_message(message, rx.is_empty());
+    if (length && write(fd, message, length) != length) {
+      std::perror("write");
+    }
+
+    usleep(1000);
+  }
+
+  std::fprintf(stderr, "%lu lines, %lu errors, %lu segments, %lu overruns\n",
+	       static_cast<unsigned long>(parser.lines()),
+	       static_cast<unsigned long>(parser.errors()),
+	       segments, overruns);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,88 @@
+/// Stream a G-code file to a device using windowed flow control.
+/**
+   Keeps the device receive buffer full by sending as long as the
+   bytes in flight are within the window, see flow_control::Host,
+   instead of waiting for a reply per line. Device output other than
+   credit messages is copied to stdout.
+
+   Usage: stream_host device file [window]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#include "src/flow_control.h"
+
+int main(int argc, char *argv[])
+{
+  if (argc < 3) {
+    std::fprintf(stderr, "Usage: %s device file [window]\n", argv[0]);
+    return 1;
+  }
+  // Receive buffer capacity of the device
+  unsigned window = argc > 3 ? std::atoi(argv[3]) : 127;
+
+  int fd = open(argv[1], O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    std::perror(argv[1]);
+    return 1;
+  }
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+
+  std::FILE *file = std::fopen(argv[2], "rb");
+  if (!file) {
+    std::perror(argv[2]);
+    return 1;
+  }
+  std::vector<char> data;
+  int c;
+  unsigned long lines = 0;
+  while ((c = std::fgetc(file)) != EOF) {
+    data.push_back(c);
+    lines += (c == '\n');
+  }
+  std::fclose(file);
+
+  flow_control::Host host(window);
+  std::size_t sent = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  while (sent < data.size() || host.bytes_in_flight() > 0) {
+    std::size_t count = std::min<std::size_t>(host.available(),
+					      data.size() - sent);
+    if (count > 0) {
+      ssize_t written = write(fd, &data[sent], count);
+      if (written > 0) {
+	host.sent(written);
+	sent += written;
+      }
+    }
+
+    char reply[64];
+    ssize_t received = read(fd, reply, sizeof(reply));
+    for (ssize_t ind = 0; ind < received; ind++) {
+      if (!host.receive(reply[ind])) {
+	std::putchar(reply[ind]);
+      }
+    }
+    if (count == 0 && received <= 0) {
+      usleep(100);
+    }
+  }
+
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  std::fprintf(stderr, "%lu lines in %.3f s, %.0f lines/s\n",
+	       lines, elapsed.count(), lines/elapsed.count());
+  close(fd);
+  return 0;
+}
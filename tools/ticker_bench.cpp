@@ -0,0 +1,218 @@
+/// Compare interrupt count and cost of the step tickers.
+/**
+   Runs the same random moves through TrapezoidTicker, in SPLIT and
+   MERGED pulse mode, and through StepQueueTicker fed by StepProducer,
+   on a fake timer and pins that only store the port writes. Reports
+   interrupts per step and host cycles per interrupt and per step of
+   the timer callbacks, the least of a few runs. StepProducer runs
+   between the callbacks, as the main loop would, and is not timed.
+   Its queues are deep enough that no axis runs out of steps while
+   another queue is full.
+
+   Usage: ticker_bench [moves]
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+#include "src/planner.h"
+#include "src/step_producer.h"
+#include "src/step_queue_ticker.h"
+#include "src/stepper_group.h"
+#include "src/trapezoid_ticker.h"
+#include "fake/timer.h"
+
+namespace {
+  std::uint64_t cycles() {
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  /// Pins that keep the port registers and nothing else
+  class PortPinIo : public PinIo {
+   public:
+    PortPinIo()
+      : ports()
+    {
+    }
+
+    void set(Pin pin) {
+      ports[port(pin)] |= bit(pin);
+    }
+
+    void clear(Pin pin) {
+      ports[port(pin)] &= ~bit(pin);
+    }
+
+    bool get(Pin pin) {
+      return ports[port(pin)] & bit(pin);
+    }
+
+    void set_mask(uint8_t port, uint8_t mask) {
+      ports[port] |= mask;
+    }
+
+    void clear_mask(uint8_t port, uint8_t mask) {
+      ports[port] &= ~mask;
+    }
+
+   private:
+    volatile uint8_t ports[32];
+  };
+
+  const unsigned axes = 4;
+
+  /// Melzi step, direction and endstop pins, E without endstop
+  const Stepper::Pins pins[axes] = {
+    {{30}, {31}, {21}, {18}},
+    {{30}, {22}, {23}, {19}},
+    {{30}, {11}, {10}, {20}},
+    {{30}, {9}, {8}, StepperGroup::no_endstop},
+  };
+
+  struct Result {
+    unsigned interrupts;
+    std::uint64_t steps;
+    std::uint64_t cycles;
+  };
+
+  void plan(Planner *planner, const std::vector<std::vector<int>>& moves) {
+    for (const auto& steps : moves) {
+      int max_steps = 0;
+      for (int axis_steps : steps) {
+	max_steps = std::max(max_steps, std::abs(axis_steps));
+      }
+      planner->plan_move(steps, max_steps/80.0f, 100, 1000, 100);
+    }
+  }
+
+  std::uint64_t steps_of(const StepperGroup& group,
+			 const std::vector<std::vector<int>>& moves) {
+    std::uint64_t steps = 0;
+    for (const auto& move : moves) {
+      for (int axis_steps : move) {
+	steps += std::abs(axis_steps);
+      }
+    }
+    // Every step is taken, the positions end at the sum of the moves
+    for (unsigned axis = 0; axis < axes; axis++) {
+      int position = 0;
+      for (const auto& move : moves) {
+	position += move[axis];
+      }
+      if (group.position(axis) != position) {
+	std::printf("axis %u at %d, not %d\n", axis, group.position(axis),
+		    position);
+      }
+    }
+    return steps;
+  }
+
+  /// Timed callback, returns its delay
+  std::uint32_t next(fake::Timer *timer, Result *result) {
+    std::uint64_t start = cycles();
+    std::uint32_t delay = timer->fake_next();
+    result->cycles += cycles() - start;
+    result->interrupts++;
+    return delay;
+  }
+
+  Result run_trapezoid(const std::vector<std::vector<int>>& moves,
+		       TrapezoidTicker::PulseMode mode) {
+    fake::Timer timer;
+    PortPinIo io;
+    StepperGroup group(&io, pins, axes, &timer);
+    group.enable();
+    Planner planner(moves.size() + 1, axes);
+    plan(&planner, moves);
+
+    TrapezoidTicker ticker(&group, &timer);
+    ticker.set_pulse_mode(mode);
+    ticker.start(&planner);
+    Result result{0, 0, 0};
+    while (next(&timer, &result)) {
+    }
+    result.steps = steps_of(group, moves);
+    return result;
+  }
+
+  Result run_queue(const std::vector<std::vector<int>>& moves) {
+    fake::Timer timer;
+    PortPinIo io;
+    StepperGroup group(&io, pins, axes, &timer);
+    group.enable();
+    Planner planner(moves.size() + 1, axes);
+    plan(&planner, moves);
+
+    std::vector<StepQueue> queues(axes, StepQueue(1024));
+    std::vector<StepQueue*> queue_ptrs;
+    for (auto& queue : queues) {
+      queue_ptrs.push_back(&queue);
+    }
+    StepProducer producer(queue_ptrs, timer.frequency(), 2);
+    StepQueueTicker ticker(&group, queue_ptrs, &timer);
+
+    Result result{0, 0, 0};
+    bool done = false;
+    do {
+      done = producer.fill(&planner);
+      ticker.start();
+      for (unsigned tick = 0; tick < 8 && next(&timer, &result); tick++) {
+      }
+    } while (!done || ticker.is_running());
+    result.steps = steps_of(group, moves);
+    return result;
+  }
+
+  template <class Run>
+  void print(const char *name, Run run) {
+    Result result = run();
+    for (unsigned repeat = 1; repeat < 5; repeat++) {
+      result.cycles = std::min(result.cycles, run().cycles);
+    }
+    std::printf("%-24s %10u %10.2f %10.1f %10.1f\n", name,
+		result.interrupts, double(result.interrupts)/result.steps,
+		double(result.cycles)/result.interrupts,
+		double(result.cycles)/result.steps);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned count = argc > 1 ? std::atoi(argv[1]) : 200;
+
+  std::srand(1);
+  std::vector<std::vector<int>> moves;
+  for (unsigned move = 0; move < count; move++) {
+    std::vector<int> steps;
+    for (unsigned axis = 0; axis < axes; axis++) {
+      steps.push_back(std::rand() % 2001 - 1000);
+    }
+    moves.push_back(steps);
+  }
+
+  std::printf("%u moves\n", count);
+  std::printf("%-24s %10s %10s %10s %10s\n", "ticker", "interrupts",
+	      "irq/step", "cyc/irq", "cyc/step");
+  print("TrapezoidTicker SPLIT", [&]() {
+      return run_trapezoid(moves, TrapezoidTicker::PulseMode::SPLIT);
+    });
+  print("TrapezoidTicker MERGED", [&]() {
+      return run_trapezoid(moves, TrapezoidTicker::PulseMode::MERGED);
+    });
+  print("StepQueueTicker", [&]() {
+      return run_queue(moves);
+    });
+  return 0;
+}
@@ -0,0 +1,136 @@
+/// Compare speed and timing error of the trapezoid generators.
+/**
+   Runs TrapezoidGenerator and ExactTrapezoidGenerator over the same
+   random feasible profiles and reports time and cycles per step, and the
+   largest difference between the summed delays and the exact event
+   times of the profile. The sum of all delays is printed as a
+   checksum, so the timed loop is kept.
+
+   Usage: trapezoid_bench [profiles [timer_frequency]]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+#include "src/trapezoid_generator.h"
+#include "src/exact_trapezoid_generator.h"
+#include "src/profile_analysis.h"
+
+namespace {
+  std::uint64_t cycles() {
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  struct Result {
+    double ns_per_step;
+    double cycles_per_step;
+    double max_error;
+    double max_total_error;
+    /// Sum of all delays, printed so the timed work is kept
+    std::uint64_t checksum;
+  };
+
+  template <class Generator, class Make>
+  Result run(const std::vector<ProfileSpec>& profiles, float f, Make make) {
+    Result result{0, 0, 0, 0, 0};
+    std::uint64_t steps = 0;
+    std::uint64_t sum = 0;
+
+    // Timing pass, delays are summed to keep the work
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t start_cycles = cycles();
+    for (const ProfileSpec& p : profiles) {
+      Generator g = make(p);
+      while (!g.is_done()) {
+	sum += g.next_delay();
+      }
+      steps += p.steps;
+    }
+    std::uint64_t used_cycles = cycles() - start_cycles;
+    std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+    result.ns_per_step = elapsed.count()/steps;
+    result.cycles_per_step = double(used_cycles)/steps;
+
+    // Error pass
+    std::vector<double> times;
+    for (const ProfileSpec& p : profiles) {
+      ProfileAnalyzer::exact_times(p, f, times);
+      Generator g = make(p);
+      std::uint64_t time = 0;
+      for (std::uint32_t event = 1; event <= p.steps; event++) {
+	time += g.next_delay();
+	double error = std::fabs(time - times[event]);
+	if (error > result.max_error) {
+	  result.max_error = error;
+	}
+      }
+      double total = std::fabs(time - times[p.steps]);
+      if (total > result.max_total_error) {
+	result.max_total_error = total;
+      }
+    }
+    result.checksum = sum;
+    return result;
+  }
+
+  void print(const char *name, const Result& result) {
+    std::printf("%-30s %8.1f %8.1f %12.2f %12.2f %14llu\n", name,
+		result.ns_per_step, result.cycles_per_step,
+		result.max_error, result.max_total_error,
+		static_cast<unsigned long long>(result.checksum));
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned count = argc > 1 ? std::atoi(argv[1]) : 1000;
+  float f = argc > 2 ? std::atof(argv[2]) : 1e6f;
+
+  std::srand(1);
+  // Only profiles the planner can produce, the ramp generators cannot
+  // follow an entry speed that does not fit the move
+  std::vector<ProfileSpec> profiles;
+  while (profiles.size() < count) {
+    ProfileSpec p;
+    p.steps = 1 + std::rand() % 20000;
+    p.nominal_rate = 100 + std::rand() % 50000;
+    p.entry_rate =
+      (std::rand() % 2) * p.nominal_rate * (std::rand() % 100) / 100;
+    p.exit_rate =
+      (std::rand() % 2) * p.nominal_rate * (std::rand() % 100) / 100;
+    p.acc = 10000 + std::rand() % 1000000;
+    if (ProfileAnalyzer::is_feasible(p)) {
+      profiles.push_back(p);
+    }
+  }
+
+  std::printf("%u profiles, timer %g Hz\n", count, f);
+  std::printf("%-30s %8s %8s %12s %12s %14s\n", "generator", "ns/step",
+	      "cyc/step", "max error", "total error", "checksum");
+
+  print("TrapezoidGenerator",
+	run<TrapezoidGenerator>(profiles, f, [f](const ProfileSpec& p) {
+	    return TrapezoidGenerator(TrapezoidParameters(
+		p.steps, p.entry_rate, p.exit_rate, p.nominal_rate, f, p.acc));
+	  }));
+  print("ExactTrapezoidGenerator",
+	run<ExactTrapezoidGenerator>(profiles, f, [f](const ProfileSpec& p) {
+	    return ExactTrapezoidGenerator(p.steps, p.entry_rate, p.exit_rate,
+					   p.nominal_rate, f, p.acc);
+	  }));
+  return 0;
+}